@@ -15,6 +15,17 @@ option(WITH_WARNINGS                  "Show all warnings during compile"
 option(WITHOUT_GIT                    "Disable the GIT testing routines"                            0)
 option(WITH_DYNAMIC_LINKING           "Enable dynamic library linking."                             0)
 option(CONFIG_ABORT_INCORRECT_OPTIONS "Enable abort if core found incorrect option in config files" 0)
+option(WITH_IO_URING                  "Use io_uring backend for network (Linux, Boost 1.78+, liburing)" 0)
+option(WITH_COROUTINES                "Build session coroutine API (requires C++20)"                0)
+option(WITH_TESTS                     "Build tests, run them with ctest"                            1)
+
+set(WARHEAD_LOG_LEVEL_FLOOR "0" CACHE STRING "Lowest log level compiled in: 0 trace, 1 debug, 2 info, 3 warning, 4 error, 5 critical")
+set_property(CACHE WARHEAD_LOG_LEVEL_FLOOR PROPERTY STRINGS 0 1 2 3 4 5)
+
+# Targets are created after this file is included, so they pick up the raised standard
+if(WITH_COROUTINES)
+  set(CMAKE_CXX_STANDARD 20)
+endif()
 
 if(WITH_DYNAMIC_LINKING)
   set(BUILD_SHARED_LIBS ON)
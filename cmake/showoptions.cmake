@@ -30,6 +30,36 @@ else()
   message("* Show compile-warnings    : No  (default)")
 endif()
 
+if (WITH_IO_URING)
+  message("* Network backend          : io_uring")
+else()
+  message("* Network backend          : default (epoll/kqueue/iocp)")
+endif()
+
+if (NOT WARHEAD_LOG_LEVEL_FLOOR MATCHES "^[0-5]$")
+  message(FATAL_ERROR "WARHEAD_LOG_LEVEL_FLOOR must be a log level from 0 (trace) to 5 (critical), got '${WARHEAD_LOG_LEVEL_FLOOR}'")
+endif()
+
+if (WARHEAD_LOG_LEVEL_FLOOR EQUAL 0)
+  message("* Log level floor          : 0 (default, all levels compiled in)")
+else()
+  message("* Log level floor          : ${WARHEAD_LOG_LEVEL_FLOOR} (lower levels compiled out)")
+endif()
+add_definitions(-DWARHEAD_LOG_LEVEL_FLOOR=${WARHEAD_LOG_LEVEL_FLOOR})
+
+if (WITH_COROUTINES)
+  message("* Session coroutines       : Yes (C++20)")
+  add_definitions(-DWARHEAD_WITH_COROUTINES)
+else()
+  message("* Session coroutines       : No  (default)")
+endif()
+
+if (WITH_TESTS)
+  message("* Build tests              : Yes (default)")
+else()
+  message("* Build tests              : No")
+endif()
+
 if (WIN32)
   if(NOT WITH_SOURCE_TREE STREQUAL "no")
     message("* Show source tree         : Yes - \"${WITH_SOURCE_TREE}\"")
@@ -17,15 +17,32 @@
 
 #include "AuthSocketMgr.h"
 #include "Config.h"
+#include "DeadlineTimer.h"
+#include "FixJournal.h"
 #include "StopWatch.h"
 #include "GitRevision.h"
 #include "Log.h"
 #include "Util.h"
+#include <boost/asio/signal_set.hpp>
+#include <csignal>
 
 #ifndef _WARHEAD_FIX_CONFIG
 #define _WARHEAD_FIX_CONFIG "WarheadFix.conf"
 #endif
 
+static void ScheduleSuppressedLogFlush(Warhead::Asio::DeadlineTimer& timer)
+{
+    timer.expires_from_now(boost::posix_time::seconds(1));
+    timer.async_wait([&timer](boost::system::error_code const& error)
+    {
+        if (error)
+            return;
+
+        sLog->FlushExpiredSuppressed();
+        ScheduleSuppressedLogFlush(timer);
+    });
+}
+
 int main(int argc, char** argv)
 {
     // Command line parsing to get the configuration file name
@@ -57,9 +74,13 @@ int main(int argc, char** argv)
     LOG_INFO("server", "{}", GitRevision::GetFullVersion());
     LOG_INFO("server", "");
 
+    sFixJournal->Initialize();
+
     std::shared_ptr<Warhead::Asio::IoContext> ioContext = std::make_shared<Warhead::Asio::IoContext>();
 
+#if LOG_LEVEL_COMPILED(DEBUG)
     StopWatch sw;
+#endif
 
     // Start the listening port (acceptor) for auth connections
     int32 port = sConfigMgr->GetOption<int32>("ServerPort", 5001);
@@ -71,16 +92,40 @@ int main(int argc, char** argv)
 
     std::string bindIp = sConfigMgr->GetOption<std::string>("BindIP", "0.0.0.0");
 
-    if (!sAuthSocketMgr.StartNetwork(*ioContext, bindIp, port))
+    int32 networkThreads = sConfigMgr->GetOption<int32>("Network.Threads", 1);
+    if (networkThreads <= 0)
+    {
+        LOG_ERROR("server", "Network.Threads must be greater than 0");
+        return 1;
+    }
+
+    if (!sAuthSocketMgr.StartNetwork(*ioContext, bindIp, port, networkThreads))
     {
         LOG_ERROR("server", "Failed to initialize network");
         return 1;
     }
 
+#if LOG_LEVEL_COMPILED(DEBUG)
     LOG_DEBUG("server", "Start network in {}", sw);
+#endif
 
     std::shared_ptr<void> sAuthSocketMgrHandle(nullptr, [](void*) { sAuthSocketMgr.StopNetwork(); });
 
+    // Set signal handlers, also keeps io service busy when all acceptors run on network threads
+    boost::asio::signal_set signals(*ioContext, SIGINT, SIGTERM);
+    signals.async_wait([ioContextRef = std::weak_ptr<Warhead::Asio::IoContext>(ioContext)](boost::system::error_code const& error, int /*signalNumber*/)
+    {
+        if (error)
+            return;
+
+        if (std::shared_ptr<Warhead::Asio::IoContext> ioContext = ioContextRef.lock())
+            ioContext->stop();
+    });
+
+    // Rate limited call sites that went quiet still report what they suppressed
+    Warhead::Asio::DeadlineTimer suppressedLogTimer(*ioContext);
+    ScheduleSuppressedLogFlush(suppressedLogTimer);
+
     // Start the io service worker loop
     ioContext->run();
 
@@ -16,6 +16,8 @@
  */
 
 #include "AuthSession.h"
+#include "AuthSocketMgr.h"
+#include "FixJournal.h"
 #include "FixMessage.h"
 #include "Timer.h"
 #include "ByteBuffer.h"
@@ -46,12 +48,43 @@ std::unordered_map<std::string, AuthHandler> const Handlers = AuthSession::InitH
 void AuthSession::Start()
 {
     LOG_TRACE("auth", "Accepted connection from {}:{}", GetRemoteIpAddress().to_string(), GetRemotePort());
+
+    if (sFixJournal->IsEnabled())
+    {
+        _journalSessionId = sFixJournal->NewSessionId();
+
+        std::string address = fmt::format("{}:{}", GetRemoteIpAddress().to_string(), GetRemotePort());
+        sFixJournal->Write(FixJournalRecordType::SessionOpen, _journalSessionId, 0, { boost::asio::buffer(address) });
+    }
+
+#ifdef WARHEAD_WITH_COROUTINES
+    RunSession(Run());
+#else
     AsyncRead();
+#endif
+}
+
+#ifdef WARHEAD_WITH_COROUTINES
+Warhead::Asio::SessionTask AuthSession::Run()
+{
+    for (;;)
+    {
+        // Result is stored first, GCC 12 miscompiles co_await used directly as a condition
+        bool open = co_await NextMessage();
+        if (!open || !HandleMessage())
+            co_return;
+
+        GetReadBuffer().Reset();
+    }
 }
+#endif
 
 void AuthSession::OnClose()
 {
     LOG_TRACE("auth", "End connection from {}:{}", GetRemoteIpAddress().to_string(), GetRemotePort());
+
+    if (sFixJournal->IsEnabled())
+        sFixJournal->Write(FixJournalRecordType::SessionClose, _journalSessionId, 0, {});
 }
 
 bool AuthSession::Update()
@@ -63,9 +96,21 @@ bool AuthSession::Update()
 }
 
 void AuthSession::ReadHandler()
+{
+    if (!HandleMessage())
+        return;
+
+    GetReadBuffer().Reset();
+    AsyncRead();
+}
+
+bool AuthSession::HandleMessage()
 {
     MessageBuffer& packet = GetReadBuffer();
 
+    if (sFixJournal->IsEnabled())
+        sFixJournal->WriteInbound(_journalSessionId, packet.GetReadPointer(), packet.GetActiveSize());
+
     // Check protocol
     {
         MessageBuffer header;
@@ -81,7 +126,7 @@ void AuthSession::ReadHandler()
         {
             LOG_ERROR("auth", "> Client {}:{} using unsupport protocol {}", GetRemoteIpAddress().to_string(), GetRemotePort(), fixProtocol);
             CloseSocket();
-            return;
+            return false;
         }
     }
 
@@ -93,31 +138,29 @@ void AuthSession::ReadHandler()
     {
         LOG_ERROR("auth", "> Client {}:{} using unknown command '{}'", GetRemoteIpAddress().to_string(), GetRemotePort(), cmd);
         //CloseSocket();
-        return;
+        return false;
     }
 
     if (_status != itr->second.status)
     {
         CloseSocket();
-        return;
+        return false;
     }
 
     if (!sFixMessage->IsValidCommand(buffer, cmd))
     {
         LOG_ERROR("auth", "> Client {}:{} using invalid command '{}'", GetRemoteIpAddress().to_string(), GetRemotePort(), cmd);
         //CloseSocket();
-        return;
+        return false;
     }
 
     if (!(*this.*itr->second.handler)())
     {
         CloseSocket();
-        return;
+        return false;
     }
 
-    packet.Reset();
-
-    AsyncRead();
+    return true;
 }
 
 void AuthSession::SendPacket(ByteBuffer& packet)
@@ -134,22 +177,76 @@ void AuthSession::SendPacket(ByteBuffer& packet)
         return;
     }
 
+    if (sFixJournal->IsEnabled())
+        sFixJournal->Write(FixJournalRecordType::Outbound, _journalSessionId, FixJournal::FindMsgSeqNum(packet.contents(), packet.size()),
+            { boost::asio::buffer(packet.contents(), packet.size()) });
+
     MessageBuffer buffer(packet.size());
     buffer.Write(packet.contents(), packet.size());
     QueuePacket(std::move(buffer));
 }
 
+void AuthSession::SendSharedPacket(std::string_view msgType, SharedMessageBuffer const& body)
+{
+    if (!IsOpen())
+    {
+        LOG_ERROR("auth", "> Can't send packet. Socket is close");
+        return;
+    }
+
+    if (!IsAuthed())
+    {
+        LOG_ERROR("auth", "> Can't send packet. Session is not logged on");
+        return;
+    }
+
+    FixSessionHeader header;
+    header.BeginString = FIX_PROTOCOL_SUPPORT;
+    header.MsgType = msgType;
+    header.SenderCompID = _senderCompId;
+    header.TargetCompID = _targetCompId;
+    header.MsgSeqNum = _sendSeqNum++;
+
+    MessageBuffer prefix(std::size_t(0));
+    MessageBuffer suffix(std::size_t(0));
+    sFixMessage->WriteSessionFraming(header, body, prefix, suffix);
+
+    if (sFixJournal->IsEnabled())
+        sFixJournal->Write(FixJournalRecordType::Outbound, _journalSessionId, header.MsgSeqNum, { boost::asio::buffer(prefix.GetReadPointer(), prefix.GetActiveSize()),
+            boost::asio::buffer(body.GetData(), body.GetSize()), boost::asio::buffer(suffix.GetReadPointer(), suffix.GetActiveSize()) });
+
+    QueuePacket(std::move(prefix), body, std::move(suffix));
+}
+
 bool AuthSession::HandleLogonMessage()
 {
     ByteBuffer buffer(std::move(MessageBuffer(GetReadBuffer())));
 
     if (sFixMessage->IsReadLogonMessage(buffer))
     {
+        std::string senderCompId = sFixMessage->GetTargetCompID(buffer);
+        std::string targetCompId = sFixMessage->GetSenderCompID(buffer);
+
+        // CompIDs are echoed in the header of every message sent to the session, keep them bounded
+        if (senderCompId.size() > FIX_MAX_COMP_ID_LENGTH || targetCompId.size() > FIX_MAX_COMP_ID_LENGTH)
+        {
+            LOG_ERROR("auth", "> Client {}:{} sent CompIDs longer than {} characters at Logon", GetRemoteIpAddress().to_string(), GetRemotePort(),
+                FIX_MAX_COMP_ID_LENGTH);
+            return false;
+        }
+
         _status = AuthStatus::Authed;
 
+        _senderCompId = std::move(senderCompId);
+        _targetCompId = std::move(targetCompId);
+
         sFixMessage->PrepareTestMessage(buffer);
         SendPacket(buffer);
 
+        // Logon reply is written first, the session moves once its write queue is empty
+        if (!_targetCompId.empty())
+            sAuthSocketMgr.PlaceSession(shared_from_this(), _targetCompId);
+
         return true;
     }
 
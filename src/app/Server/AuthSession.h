@@ -46,15 +46,33 @@ public:
 
     void SendPacket(ByteBuffer& packet);
 
+    // Frame and queue a FIX body shared with other sessions, only header and trailer are encoded for this session
+    void SendSharedPacket(std::string_view msgType, SharedMessageBuffer const& body);
+
+    bool IsAuthed() const { return _status == AuthStatus::Authed; }
+
 protected:
     void ReadHandler() override;
     void OnClose() override;
 
 private:
+#ifdef WARHEAD_WITH_COROUTINES
+    Warhead::Asio::SessionTask Run();
+#endif
+
+    // Returns false if reading should stop, the socket is closed unless the message is just ignored
+    bool HandleMessage();
+
     bool HandleLogonMessage();
     bool HandleNewOrderSingleMessage();
 
     AuthStatus _status{ AuthStatus::NotAuthed };
+    uint32 _sendSeqNum{ 1 };
+    uint32 _journalSessionId{ 0 };
+
+    // CompIDs of messages sent to the counterparty, its Logon CompIDs swapped
+    std::string _senderCompId;
+    std::string _targetCompId;
 };
 
 #endif
@@ -0,0 +1,147 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef HandlerAllocator_h__
+#define HandlerAllocator_h__
+
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Warhead::Asio
+{
+    // Storage for the operation of one asynchronous call chain (e.g. the read loop of a socket).
+    // Asio frees the operation before invoking its handler, so the next operation started by the handler reuses the storage.
+    // Operations larger than the storage, or started while the storage is in use, fall back to the heap.
+    // Lives outside of its owner: a pending operation destroyed with the io_context may hold the last reference to the owner
+    class HandlerMemory
+    {
+    public:
+        static constexpr std::size_t STORAGE_SIZE = 256;
+
+        struct Deleter
+        {
+            void operator()(HandlerMemory* memory) const noexcept { Destroy(memory); }
+        };
+
+        static std::unique_ptr<HandlerMemory, Deleter> Create() { return std::unique_ptr<HandlerMemory, Deleter>(new HandlerMemory()); }
+
+        HandlerMemory(HandlerMemory const&) = delete;
+        HandlerMemory& operator=(HandlerMemory const&) = delete;
+
+        void* Allocate(std::size_t size)
+        {
+            if (!_inUse && size <= sizeof(_storage))
+            {
+                _inUse = true;
+                return &_storage;
+            }
+
+            return ::operator new(size);
+        }
+
+        void Deallocate(void* pointer) noexcept
+        {
+            if (pointer != &_storage)
+            {
+                ::operator delete(pointer);
+                return;
+            }
+
+            _inUse = false;
+
+            if (_orphaned)
+                delete this;
+        }
+
+    private:
+        HandlerMemory() = default;
+        ~HandlerMemory() = default;
+
+        // Owner is gone, storage still in use is freed by the last Deallocate
+        static void Destroy(HandlerMemory* memory) noexcept
+        {
+            if (memory->_inUse)
+                memory->_orphaned = true;
+            else
+                delete memory;
+        }
+
+        std::aligned_storage_t<STORAGE_SIZE> _storage;
+        bool _inUse{ false };
+        bool _orphaned{ false };
+    };
+
+    using HandlerMemoryPtr = std::unique_ptr<HandlerMemory, HandlerMemory::Deleter>;
+
+    // Allocator associated with handlers wrapped by BindHandlerMemory
+    template<typename T>
+    class HandlerAllocator
+    {
+    public:
+        using value_type = T;
+
+        explicit HandlerAllocator(HandlerMemory& memory) noexcept : _memory(&memory) { }
+
+        template<typename U>
+        HandlerAllocator(HandlerAllocator<U> const& other) noexcept : _memory(other._memory) { }
+
+        T* allocate(std::size_t count) { return static_cast<T*>(_memory->Allocate(sizeof(T) * count)); }
+        void deallocate(T* pointer, std::size_t /*count*/) noexcept { _memory->Deallocate(pointer); }
+
+        template<typename U>
+        bool operator==(HandlerAllocator<U> const& other) const noexcept { return _memory == other._memory; }
+
+        template<typename U>
+        bool operator!=(HandlerAllocator<U> const& other) const noexcept { return _memory != other._memory; }
+
+    private:
+        template<typename>
+        friend class HandlerAllocator;
+
+        HandlerMemory* _memory;
+    };
+
+    template<typename Handler>
+    class MemoryBoundHandler
+    {
+    public:
+        using allocator_type = HandlerAllocator<Handler>;
+
+        MemoryBoundHandler(HandlerMemory& memory, Handler&& handler) : _memory(memory), _handler(std::move(handler)) { }
+
+        allocator_type get_allocator() const noexcept { return allocator_type(_memory); }
+
+        template<typename... Args>
+        void operator()(Args&&... args) { _handler(std::forward<Args>(args)...); }
+
+    private:
+        HandlerMemory& _memory;
+        Handler _handler;
+    };
+
+    // Make asio allocate the operation of handler from memory. Memory must outlive the operation
+    template<typename Handler>
+    inline MemoryBoundHandler<std::decay_t<Handler>> BindHandlerMemory(HandlerMemory& memory, Handler&& handler)
+    {
+        return MemoryBoundHandler<std::decay_t<Handler>>(memory, std::decay_t<Handler>(std::forward<Handler>(handler)));
+    }
+}
+
+#endif // HandlerAllocator_h__
@@ -33,7 +33,10 @@ namespace Warhead::Asio
         operator boost::asio::io_context const&() const { return _impl; }
 
         std::size_t run() { return _impl.run(); }
+        std::size_t run_one() { return _impl.run_one(); }
+        std::size_t poll() { return _impl.poll(); }
         void stop() { _impl.stop(); }
+        bool stopped() const { return _impl.stopped(); }
 
         boost::asio::io_context::executor_type get_executor() noexcept { return _impl.get_executor(); }
 
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SessionTask_h__
+#define SessionTask_h__
+
+#ifdef WARHEAD_WITH_COROUTINES
+
+#include <concepts>
+#include <coroutine>
+#include <cstddef>
+#include <new>
+#include <utility>
+
+namespace Warhead::Asio
+{
+    // Storage for the coroutine frame of one session, kept by the session itself.
+    // Frames larger than the storage, or started while the storage is in use, fall back to the heap.
+    // Every frame starts with a header telling Deallocate where it came from
+    class FrameMemory
+    {
+    public:
+        static constexpr std::size_t STORAGE_SIZE = 512;
+
+        FrameMemory() = default;
+        FrameMemory(FrameMemory const&) = delete;
+        FrameMemory& operator=(FrameMemory const&) = delete;
+
+        // memory may be null, the frame is then always taken from the heap
+        static void* Allocate(FrameMemory* memory, std::size_t size)
+        {
+            void* block;
+            if (memory && !memory->_inUse && size + HEADER_SIZE <= sizeof(memory->_storage))
+            {
+                memory->_inUse = true;
+                block = &memory->_storage;
+            }
+            else
+            {
+                block = ::operator new(size + HEADER_SIZE);
+                memory = nullptr;
+            }
+
+            *static_cast<FrameMemory**>(block) = memory;
+            return static_cast<std::byte*>(block) + HEADER_SIZE;
+        }
+
+        static void Deallocate(void* frame) noexcept
+        {
+            void* block = static_cast<std::byte*>(frame) - HEADER_SIZE;
+
+            if (FrameMemory* memory = *static_cast<FrameMemory**>(block))
+                memory->_inUse = false;
+            else
+                ::operator delete(block);
+        }
+
+    private:
+        // Keeps the frame aligned for any type
+        static constexpr std::size_t HEADER_SIZE = alignof(std::max_align_t);
+
+        alignas(std::max_align_t) std::byte _storage[STORAGE_SIZE];
+        bool _inUse{ false };
+    };
+
+    // Coroutine running the logic of one session. It starts suspended, Resume() runs it until the first co_await.
+    // Frame is allocated from the FrameMemory of the session when the coroutine is a member of a class providing
+    // GetFrameMemory(), and is destroyed with the task. Exceptions leave through the Resume() or completion handler that resumed it
+    class SessionTask
+    {
+    public:
+        struct promise_type
+        {
+            SessionTask get_return_object() { return SessionTask(std::coroutine_handle<promise_type>::from_promise(*this)); }
+
+            std::suspend_always initial_suspend() noexcept { return {}; }
+            std::suspend_always final_suspend() noexcept { return {}; }
+
+            void return_void() noexcept { }
+            void unhandled_exception() { throw; }
+
+            template<typename Session, typename... Args>
+            requires requires(Session& session) { { session.GetFrameMemory() } -> std::same_as<FrameMemory&>; }
+            static void* operator new(std::size_t size, Session& session, Args&&...)
+            {
+                return FrameMemory::Allocate(&session.GetFrameMemory(), size);
+            }
+
+            static void* operator new(std::size_t size) { return FrameMemory::Allocate(nullptr, size); }
+            static void operator delete(void* frame) noexcept { FrameMemory::Deallocate(frame); }
+        };
+
+        SessionTask() = default;
+        SessionTask(SessionTask&& other) noexcept : _handle(std::exchange(other._handle, nullptr)) { }
+
+        SessionTask& operator=(SessionTask&& other) noexcept
+        {
+            if (this != &other)
+            {
+                Destroy();
+                _handle = std::exchange(other._handle, nullptr);
+            }
+
+            return *this;
+        }
+
+        ~SessionTask() { Destroy(); }
+
+        void Resume()
+        {
+            if (_handle && !_handle.done())
+                _handle.resume();
+        }
+
+        bool IsDone() const { return !_handle || _handle.done(); }
+
+    private:
+        explicit SessionTask(std::coroutine_handle<promise_type> handle) : _handle(handle) { }
+
+        void Destroy()
+        {
+            if (_handle)
+                std::exchange(_handle, nullptr).destroy();
+        }
+
+        std::coroutine_handle<promise_type> _handle;
+    };
+}
+
+#endif // WARHEAD_WITH_COROUTINES
+
+#endif // SessionTask_h__
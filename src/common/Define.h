@@ -53,6 +53,12 @@
 #  endif
 #endif
 
+// Alignment that keeps data written by different threads on separate cache lines.
+// std::hardware_destructive_interference_size is not stable across compiler flags, so it is not used in headers
+#if !defined(WARHEAD_CACHE_LINE_SIZE)
+#  define WARHEAD_CACHE_LINE_SIZE 64
+#endif
+
 #if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
 #define _USE_MATH_DEFINES
 #endif //WARHEAD_PLATFORM
@@ -0,0 +1,192 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncLogger.h"
+#include "ThreadUtils.h"
+#include <spdlog/sinks/sink.h>
+#include <chrono>
+#include <exception>
+#include <vector>
+
+namespace
+{
+    // Writer polls the queue this often while there is log traffic, messages reach the sinks with at most this delay
+    constexpr std::chrono::milliseconds IDLE_POLL_INTERVAL(1);
+
+    // Empty polls before the writer sleeps until the next message
+    constexpr uint32 IDLE_POLL_COUNT = 100;
+}
+
+AsyncLogQueue::AsyncLogQueue(std::size_t capacity, LogOverflowPolicy policy) : _queue(capacity), _policy(policy)
+{
+    _thread = std::thread([this]()
+    {
+        Warhead::Thread::SetCurrentThreadName("Log Writer");
+        Run();
+    });
+}
+
+AsyncLogQueue::~AsyncLogQueue()
+{
+    // Queue is FIFO, the writer thread sees the terminate request after all earlier messages
+    Enqueue(Item(ItemType::Terminate, nullptr), LogOverflowPolicy::Block);
+
+    if (_thread.joinable())
+        _thread.join();
+}
+
+void AsyncLogQueue::Post(std::shared_ptr<AsyncLogger> logger, spdlog::details::log_msg const& msg)
+{
+    Enqueue(Item(std::move(logger), msg), _policy);
+}
+
+void AsyncLogQueue::PostFlush(std::shared_ptr<AsyncLogger> logger)
+{
+    Enqueue(Item(ItemType::Flush, std::move(logger)), LogOverflowPolicy::Block);
+}
+
+void AsyncLogQueue::Enqueue(Item&& item, LogOverflowPolicy policy)
+{
+    switch (policy)
+    {
+        case LogOverflowPolicy::Block:
+            _queue.Push(std::move(item));
+            break;
+        case LogOverflowPolicy::DropNewest:
+            if (!_queue.TryPush(std::move(item)))
+                _dropped.fetch_add(1, std::memory_order_relaxed);
+            break;
+        case LogOverflowPolicy::DropOldest:
+        {
+            // Only messages are dropped. Flush and terminate requests taken out to make room are queued again behind
+            // the new message, the same way, so a stalled writer can't block the logging thread here
+            std::vector<Item> requests;
+            for (;;)
+            {
+                while (!_queue.TryPush(std::move(item)))
+                {
+                    // Writer thread may take the oldest message first, then there is room without dropping
+                    Item oldest;
+                    if (!_queue.TryPop(oldest))
+                        continue;
+
+                    if (oldest.Type == ItemType::Log)
+                        _dropped.fetch_add(1, std::memory_order_relaxed);
+                    else
+                        requests.push_back(std::move(oldest));
+                }
+
+                if (requests.empty())
+                    break;
+
+                item = std::move(requests.back());
+                requests.pop_back();
+            }
+            break;
+        }
+        default:
+            break;
+    }
+}
+
+void AsyncLogQueue::Run()
+{
+    uint32 idlePolls = 0;
+
+    for (;;)
+    {
+        Item item;
+        if (_queue.TryPop(item))
+            idlePolls = 0;
+        else if (idlePolls < IDLE_POLL_COUNT)
+        {
+            // Polling keeps the writer awake while messages keep coming, a logging thread only pays for a futex wake
+            // when it logs first after a quiet period
+            ++idlePolls;
+            std::this_thread::sleep_for(IDLE_POLL_INTERVAL);
+            continue;
+        }
+        else if (!_queue.WaitAndPop(item))
+            return;
+
+        switch (item.Type)
+        {
+            case ItemType::Log:
+                item.Logger->WriteToSinks(item.Message);
+                break;
+            case ItemType::Flush:
+                item.Logger->FlushSinks();
+                break;
+            case ItemType::Terminate:
+                return;
+        }
+    }
+}
+
+AsyncLogger::AsyncLogger(std::string name, std::vector<spdlog::sink_ptr> sinks, std::shared_ptr<AsyncLogQueue> queue) :
+    spdlog::logger(std::move(name), sinks.begin(), sinks.end()), _queue(std::move(queue))
+{
+}
+
+void AsyncLogger::sink_it_(spdlog::details::log_msg const& msg)
+{
+    if (std::shared_ptr<AsyncLogQueue> queue = _queue.lock())
+        queue->Post(shared_from_this(), msg);
+}
+
+void AsyncLogger::flush_()
+{
+    if (std::shared_ptr<AsyncLogQueue> queue = _queue.lock())
+        queue->PostFlush(shared_from_this());
+}
+
+void AsyncLogger::WriteToSinks(spdlog::details::log_msg const& msg)
+{
+    for (auto& sink : sinks_)
+    {
+        if (!sink->should_log(msg.level))
+            continue;
+
+        try
+        {
+            sink->log(msg);
+        }
+        catch (std::exception const& e)
+        {
+            err_handler_(e.what());
+        }
+    }
+
+    // Flush on the writer thread itself, a flush request posted from here could wait on a full queue forever
+    if (should_flush_(msg))
+        FlushSinks();
+}
+
+void AsyncLogger::FlushSinks()
+{
+    for (auto& sink : sinks_)
+    {
+        try
+        {
+            sink->flush();
+        }
+        catch (std::exception const& e)
+        {
+            err_handler_(e.what());
+        }
+    }
+}
@@ -0,0 +1,111 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ASYNC_LOGGER_H_
+#define _ASYNC_LOGGER_H_
+
+#include "Define.h"
+#include "MPMCQueue.h"
+#include <spdlog/details/log_msg_buffer.h>
+#include <spdlog/logger.h>
+#include <atomic>
+#include <memory>
+#include <thread>
+
+// What a logging thread does when the async log queue is full
+enum class LogOverflowPolicy : uint8
+{
+    Block,      // Wait for the writer thread
+    DropNewest, // Discard the message being logged
+    DropOldest, // Discard the oldest queued message to make room
+
+    Max
+};
+
+class AsyncLogger;
+
+// Bounded queue and background thread writing messages of all async loggers to their sinks.
+// Messages are copied into the queue, formatting by the sink pattern and I/O happen on the writer thread
+class WH_COMMON_API AsyncLogQueue
+{
+public:
+    AsyncLogQueue(std::size_t capacity, LogOverflowPolicy policy);
+
+    // Writes everything queued so far, then stops the writer thread
+    ~AsyncLogQueue();
+
+    void Post(std::shared_ptr<AsyncLogger> logger, spdlog::details::log_msg const& msg);
+
+    // Flush requests always wait for room, they are never dropped
+    void PostFlush(std::shared_ptr<AsyncLogger> logger);
+
+    uint64 GetDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    enum class ItemType : uint8
+    {
+        Log,
+        Flush,
+        Terminate
+    };
+
+    struct Item
+    {
+        Item() = default;
+        Item(ItemType type, std::shared_ptr<AsyncLogger> logger) : Type(type), Logger(std::move(logger)) { }
+        Item(std::shared_ptr<AsyncLogger> logger, spdlog::details::log_msg const& msg) : Type(ItemType::Log), Logger(std::move(logger)), Message(msg) { }
+
+        ItemType Type{ ItemType::Terminate };
+        std::shared_ptr<AsyncLogger> Logger;
+        spdlog::details::log_msg_buffer Message;
+    };
+
+    void Enqueue(Item&& item, LogOverflowPolicy policy);
+    void Run();
+
+    Warhead::MPMCQueue<Item> _queue;
+    LogOverflowPolicy const _policy;
+    std::atomic<uint64> _dropped{ 0 };
+    std::thread _thread;
+
+    AsyncLogQueue(AsyncLogQueue const&) = delete;
+    AsyncLogQueue& operator=(AsyncLogQueue const&) = delete;
+};
+
+// Logger handing its messages to an AsyncLogQueue instead of writing to the sinks on the calling thread.
+// Queue is owned by Log, messages logged after it is gone are discarded
+class WH_COMMON_API AsyncLogger : public spdlog::logger, public std::enable_shared_from_this<AsyncLogger>
+{
+    friend class AsyncLogQueue;
+
+public:
+    AsyncLogger(std::string name, std::vector<spdlog::sink_ptr> sinks, std::shared_ptr<AsyncLogQueue> queue);
+
+protected:
+    void sink_it_(spdlog::details::log_msg const& msg) override;
+    void flush_() override;
+
+private:
+    // Called on the writer thread
+    void WriteToSinks(spdlog::details::log_msg const& msg);
+    void FlushSinks();
+
+    // Queued messages hold their logger, a strong reference back would let the writer thread destroy its own queue
+    std::weak_ptr<AsyncLogQueue> _queue;
+};
+
+#endif // _ASYNC_LOGGER_H_
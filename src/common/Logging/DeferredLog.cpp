@@ -0,0 +1,514 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DeferredLog.h"
+#include "ThreadUtils.h"
+#include <spdlog/details/os.h>
+#include <fmt/args.h>
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace Warhead::DeferredLog;
+
+namespace
+{
+    // Background thread drains the staging buffers this often, messages reach the sinks with at most this delay
+    constexpr std::chrono::milliseconds POLL_INTERVAL(1);
+
+    class Registry
+    {
+    public:
+        static Registry& Instance()
+        {
+            static Registry instance;
+            return instance;
+        }
+
+        uint32 RegisterCallSite(CallSite& site, std::string_view filter, uint8 level, char const* file, int line, char const* function, std::string_view format);
+        StagingBuffer* CreateBuffer();
+
+        bool Start(std::size_t bufferSize, bool block, std::string const& binaryFile, MessageHandler handler);
+        void Stop();
+
+        bool IsRunning() const { return _running.load(std::memory_order_acquire); }
+        bool IsBlocking() const { return _block.load(std::memory_order_relaxed); }
+        void AddDropped() { _dropped.fetch_add(1, std::memory_order_relaxed); }
+        uint64 GetDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+    private:
+        Registry() = default;
+        ~Registry() { Stop(); }
+
+        void Run();
+
+        // Returns false if there was nothing to write
+        bool Drain();
+        void WriteRecords(uint8 const* data, std::size_t size);
+        CallSiteInfo const* GetCallSite(uint32 id);
+        void WriteCallSite(CallSiteInfo const& site);
+
+        std::mutex _lock;
+        std::vector<CallSiteInfo> _callSites;
+        std::vector<std::unique_ptr<StagingBuffer>> _buffers;
+
+        std::atomic<std::size_t> _bufferSize{ 1024 * 1024 };
+        std::atomic<bool> _block{ true };
+        std::atomic<bool> _running{ false };
+        std::atomic<bool> _stop{ false };
+        std::atomic<uint64> _dropped{ 0 };
+        std::thread _thread;
+
+        // Background thread only
+        MessageHandler _handler;
+        FILE* _file{ nullptr };
+        bool _fileDirty{ false };
+        std::vector<CallSiteInfo> _localCallSites;
+        std::vector<bool> _writtenCallSites;
+        std::vector<StagingBuffer*> _drainList;
+        std::vector<uint8> _record;
+        std::string _message;
+    };
+
+    struct BufferHolder
+    {
+        ~BufferHolder()
+        {
+            if (Buffer)
+                Buffer->Retire();
+        }
+
+        StagingBuffer* Buffer{ nullptr };
+    };
+
+    template<typename T>
+    inline bool Get(uint8 const*& data, uint8 const* end, T& value)
+    {
+        if (std::size_t(end - data) < sizeof(T))
+            return false;
+
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+
+    inline void PutString(std::vector<uint8>& out, std::string_view string)
+    {
+        uint32 length = static_cast<uint32>(string.size());
+        out.insert(out.end(), reinterpret_cast<uint8 const*>(&length), reinterpret_cast<uint8 const*>(&length) + sizeof(length));
+        out.insert(out.end(), string.begin(), string.end());
+    }
+}
+
+// Value initialization touches every page up front, not on the logging hot path
+StagingBuffer::StagingBuffer(std::size_t capacity, uint32 threadId) :
+    _storage(new uint8[capacity]()), _capacity(capacity), _threadId(threadId)
+{
+}
+
+StagingBuffer::~StagingBuffer()
+{
+    delete[] _storage;
+}
+
+std::pair<uint8 const*, std::size_t> StagingBuffer::Peek()
+{
+    std::size_t producerPos = _producerPosShared.load(std::memory_order_acquire);
+    std::size_t consumerPos = _consumerPos.load(std::memory_order_relaxed);
+
+    if (producerPos >= consumerPos)
+        return { _storage + consumerPos, producerPos - consumerPos };
+
+    // Producer wrapped around, records up to the end of recorded space come first
+    std::size_t endOfRecords = _endOfRecords.load(std::memory_order_relaxed);
+    if (consumerPos < endOfRecords)
+        return { _storage + consumerPos, endOfRecords - consumerPos };
+
+    _consumerPos.store(0, std::memory_order_release);
+    return { _storage, producerPos };
+}
+
+void StagingBuffer::Consume(std::size_t size)
+{
+    _consumerPos.store(_consumerPos.load(std::memory_order_relaxed) + size, std::memory_order_release);
+}
+
+uint32 Registry::RegisterCallSite(CallSite& site, std::string_view filter, uint8 level, char const* file, int line, char const* function, std::string_view format)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    // Other thread got here first
+    if (uint32 id = site.Id.load(std::memory_order_relaxed))
+        return id;
+
+    CallSiteInfo& info = _callSites.emplace_back();
+    info.Id = static_cast<uint32>(_callSites.size());
+    info.Level = level;
+    info.Line = static_cast<uint32>(line);
+    info.Filter = filter;
+    info.Format = format;
+    info.File = file ? file : "";
+    info.Function = function ? function : "";
+
+    site.Id.store(info.Id, std::memory_order_release);
+    return info.Id;
+}
+
+StagingBuffer* Registry::CreateBuffer()
+{
+    auto buffer = std::make_unique<StagingBuffer>(_bufferSize.load(std::memory_order_relaxed), static_cast<uint32>(spdlog::details::os::thread_id()));
+
+    std::lock_guard<std::mutex> lock(_lock);
+    return _buffers.emplace_back(std::move(buffer)).get();
+}
+
+bool Registry::Start(std::size_t bufferSize, bool block, std::string const& binaryFile, MessageHandler handler)
+{
+    Stop();
+
+    if (!binaryFile.empty())
+    {
+        _file = std::fopen(binaryFile.c_str(), "wb");
+        if (!_file)
+            return false;
+
+        std::fwrite(FILE_MAGIC, 1, sizeof(FILE_MAGIC), _file);
+    }
+
+    _handler = std::move(handler);
+    _bufferSize.store(bufferSize, std::memory_order_relaxed);
+    _block.store(block, std::memory_order_relaxed);
+    _dropped.store(0, std::memory_order_relaxed);
+    _stop.store(false, std::memory_order_relaxed);
+    _running.store(true, std::memory_order_release);
+
+    _thread = std::thread([this]()
+    {
+        Warhead::Thread::SetCurrentThreadName("Log Formatter");
+        Run();
+    });
+
+    return true;
+}
+
+void Registry::Stop()
+{
+    if (!_thread.joinable())
+        return;
+
+    _stop.store(true, std::memory_order_release);
+    _thread.join();
+    _running.store(false, std::memory_order_release);
+
+    if (_file)
+    {
+        std::fclose(_file);
+        _file = nullptr;
+    }
+
+    _handler = nullptr;
+    _writtenCallSites.clear();
+}
+
+void Registry::Run()
+{
+    while (!_stop.load(std::memory_order_acquire))
+    {
+        if (Drain())
+            continue;
+
+        if (_fileDirty)
+        {
+            std::fflush(_file);
+            _fileDirty = false;
+        }
+
+        std::this_thread::sleep_for(POLL_INTERVAL);
+    }
+
+    // Logging threads may still be blocked on a full buffer, keep draining until nothing is left
+    while (Drain()) { }
+
+    if (_fileDirty)
+    {
+        std::fflush(_file);
+        _fileDirty = false;
+    }
+}
+
+bool Registry::Drain()
+{
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        // Buffers of exited threads are freed once everything staged in them is written
+        _buffers.erase(std::remove_if(_buffers.begin(), _buffers.end(), [](std::unique_ptr<StagingBuffer> const& buffer)
+        {
+            return buffer->IsRetired() && !buffer->Peek().second;
+        }), _buffers.end());
+
+        _drainList.clear();
+        for (auto const& buffer : _buffers)
+            _drainList.push_back(buffer.get());
+    }
+
+    bool written = false;
+
+    for (StagingBuffer* buffer : _drainList)
+    {
+        auto [data, size] = buffer->Peek();
+        if (!size)
+            continue;
+
+        WriteRecords(data, size);
+        buffer->Consume(size);
+        written = true;
+    }
+
+    return written;
+}
+
+void Registry::WriteRecords(uint8 const* data, std::size_t size)
+{
+    uint8 const* end = data + size;
+
+    while (data < end)
+    {
+        uint8 const* record = data;
+
+        RecordType type{};
+        uint32 id = 0;
+        uint32 argsSize = 0;
+        int64 time = 0;
+        uint32 threadId = 0;
+
+        // Records are written by this process, a malformed one means the buffer is corrupted
+        if (!Get(data, end, type) || type != RecordType::Message || !Get(data, end, id) || !Get(data, end, argsSize) ||
+            !Get(data, end, time) || !Get(data, end, threadId) || std::size_t(end - data) < argsSize)
+            return;
+
+        data += argsSize;
+
+        CallSiteInfo const* site = GetCallSite(id);
+        if (!site)
+            continue;
+
+        if (_file)
+        {
+            if (id > _writtenCallSites.size())
+                _writtenCallSites.resize(id, false);
+
+            if (!_writtenCallSites[id - 1])
+            {
+                WriteCallSite(*site);
+                _writtenCallSites[id - 1] = true;
+            }
+
+            std::fwrite(record, 1, data - record, _file);
+            _fileDirty = true;
+        }
+        else if (_handler)
+        {
+            _message.clear();
+            if (FormatMessage(site->Format, data - argsSize, argsSize, _message))
+                _handler(*site, time, _message);
+        }
+    }
+}
+
+CallSiteInfo const* Registry::GetCallSite(uint32 id)
+{
+    if (!id)
+        return nullptr;
+
+    // Local copy, the shared list grows while logging threads register call sites
+    if (id > _localCallSites.size())
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+        _localCallSites.insert(_localCallSites.end(), _callSites.begin() + _localCallSites.size(), _callSites.end());
+    }
+
+    return id <= _localCallSites.size() ? &_localCallSites[id - 1] : nullptr;
+}
+
+void Registry::WriteCallSite(CallSiteInfo const& site)
+{
+    _record.clear();
+    _record.push_back(static_cast<uint8>(RecordType::CallSite));
+    _record.insert(_record.end(), reinterpret_cast<uint8 const*>(&site.Id), reinterpret_cast<uint8 const*>(&site.Id) + sizeof(site.Id));
+    _record.push_back(site.Level);
+    _record.insert(_record.end(), reinterpret_cast<uint8 const*>(&site.Line), reinterpret_cast<uint8 const*>(&site.Line) + sizeof(site.Line));
+    PutString(_record, site.Filter);
+    PutString(_record, site.Format);
+    PutString(_record, site.File);
+    PutString(_record, site.Function);
+
+    std::fwrite(_record.data(), 1, _record.size(), _file);
+}
+
+uint32 Warhead::DeferredLog::RegisterCallSite(CallSite& site, std::string_view filter, uint8 level, char const* file, int line, char const* function, std::string_view format)
+{
+    return Registry::Instance().RegisterCallSite(site, filter, level, file, line, function, format);
+}
+
+StagingBuffer& Warhead::DeferredLog::GetStagingBuffer()
+{
+    thread_local BufferHolder holder;
+
+    if (!holder.Buffer)
+        holder.Buffer = Registry::Instance().CreateBuffer();
+
+    return *holder.Buffer;
+}
+
+uint8* Warhead::DeferredLog::ReserveSlow(StagingBuffer& buffer, std::size_t size)
+{
+    Registry& registry = Registry::Instance();
+
+    // Would never fit
+    if (size >= buffer.GetCapacity())
+    {
+        registry.AddDropped();
+        return nullptr;
+    }
+
+    while (registry.IsBlocking() && registry.IsRunning())
+    {
+        std::this_thread::yield();
+
+        if (uint8* out = buffer.Reserve(size))
+            return out;
+    }
+
+    registry.AddDropped();
+    return nullptr;
+}
+
+bool Warhead::DeferredLog::Start(std::size_t bufferSize, bool block, std::string const& binaryFile, MessageHandler handler)
+{
+    return Registry::Instance().Start(bufferSize, block, binaryFile, std::move(handler));
+}
+
+void Warhead::DeferredLog::Stop()
+{
+    Registry::Instance().Stop();
+}
+
+uint64 Warhead::DeferredLog::GetDroppedCount()
+{
+    return Registry::Instance().GetDroppedCount();
+}
+
+bool Warhead::DeferredLog::FormatMessage(std::string_view format, uint8 const* args, std::size_t size, std::string& message)
+{
+    // Strings are referenced, not copied, they stay valid in args until formatting is done
+    thread_local fmt::dynamic_format_arg_store<fmt::format_context> store;
+    store.clear();
+
+    uint8 const* end = args + size;
+
+    while (args < end)
+    {
+        ArgType type{};
+        if (!Get(args, end, type))
+            return false;
+
+        switch (type)
+        {
+            case ArgType::Bool:
+            {
+                bool value = false;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::Char:
+            {
+                char value = 0;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::Int:
+            {
+                int64 value = 0;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::UInt:
+            {
+                uint64 value = 0;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::Double:
+            {
+                double value = 0;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::Pointer:
+            {
+                void const* value = nullptr;
+                if (!Get(args, end, value))
+                    return false;
+
+                store.push_back(value);
+                break;
+            }
+            case ArgType::String:
+            {
+                uint32 length = 0;
+                if (!Get(args, end, length) || std::size_t(end - args) < length)
+                    return false;
+
+                store.push_back(std::string_view(reinterpret_cast<char const*>(args), length));
+                args += length;
+                break;
+            }
+            default:
+                return false;
+        }
+    }
+
+    try
+    {
+        fmt::vformat_to(std::back_inserter(message), format, store);
+    }
+    catch (fmt::format_error const& e)
+    {
+        message = fmt::format("Wrong format occurred ({}) for '{}'", e.what(), format);
+    }
+
+    return true;
+}
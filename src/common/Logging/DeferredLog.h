@@ -0,0 +1,292 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _DEFERRED_LOG_H_
+#define _DEFERRED_LOG_H_
+
+#include "Define.h"
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <tuple>
+#include <type_traits>
+#include <fmt/format.h>
+
+// Deferred formatting of LOG_* messages. The call site copies a call site id and its raw arguments into a
+// staging buffer owned by the calling thread, a background thread formats them to the loggers or writes them
+// unformatted to a binary log file, which the logdecoder tool turns into text.
+//
+// Binary format, host byte order. Staging buffers hold message records only, files start with FILE_MAGIC and
+// every call site record precedes the first message of the call site:
+//   call site: uint8 RecordType::CallSite, uint32 id, uint8 level, uint32 line, string filter, string format, string file, string function
+//   message:   uint8 RecordType::Message, uint32 call site id, uint32 args size, int64 time (ns since epoch), uint32 thread id, args
+//   arg:       uint8 ArgType, then 1 byte (Bool, Char), 8 bytes (Int, UInt, Double, Pointer) or string
+//   string:    uint32 length, bytes
+namespace Warhead::DeferredLog
+{
+    constexpr char FILE_MAGIC[8] = { 'W', 'H', 'D', 'L', 'O', 'G', '0', '1' };
+
+    enum class RecordType : uint8
+    {
+        CallSite = 1,
+        Message  = 2
+    };
+
+    enum class ArgType : uint8
+    {
+        Bool,
+        Char,
+        Int,
+        UInt,
+        Double,
+        String,
+        Pointer,
+
+        Max
+    };
+
+    constexpr std::size_t MESSAGE_HEADER_SIZE = sizeof(uint8) + sizeof(uint32) + sizeof(uint32) + sizeof(int64) + sizeof(uint32);
+
+    // One LOG_* call site, registered with its format string, location and filter on first use.
+    // Filter of the first call is kept, call sites must use a constant filter
+    struct CallSite
+    {
+        std::atomic<uint32> Id{ 0 };
+    };
+
+    struct CallSiteInfo
+    {
+        uint32 Id{ 0 };
+        uint8 Level{ 0 };
+        uint32 Line{ 0 };
+        std::string Filter;
+        std::string Format;
+        std::string File;
+        std::string Function;
+    };
+
+    // Single producer, single consumer ring of variable size records. Owned by one logging thread,
+    // drained by the background thread
+    class WH_COMMON_API StagingBuffer
+    {
+    public:
+        StagingBuffer(std::size_t capacity, uint32 threadId);
+        ~StagingBuffer();
+
+        // Contiguous space for size bytes, null if the buffer is full
+        uint8* Reserve(std::size_t size)
+        {
+            if (size < Free())
+                return _storage + _producerPos;
+
+            _cachedConsumerPos = _consumerPos.load(std::memory_order_acquire);
+            if (size < Free())
+                return _storage + _producerPos;
+
+            // Not enough room before the end, start over from the beginning if the consumer left room there
+            if (_producerPos >= _cachedConsumerPos && size < _cachedConsumerPos)
+            {
+                _endOfRecords.store(_producerPos, std::memory_order_relaxed);
+                _producerPos = 0;
+                _producerPosShared.store(0, std::memory_order_release);
+                return _storage;
+            }
+
+            return nullptr;
+        }
+
+        void Commit(std::size_t size)
+        {
+            _producerPos += size;
+            _producerPosShared.store(_producerPos, std::memory_order_release);
+        }
+
+        // Consumer side: contiguous committed bytes, consumed by Consume
+        std::pair<uint8 const*, std::size_t> Peek();
+        void Consume(std::size_t size);
+
+        uint32 GetThreadId() const { return _threadId; }
+        std::size_t GetCapacity() const { return _capacity; }
+
+        // Owner thread exited, buffer is freed once drained
+        void Retire() { _retired.store(true, std::memory_order_release); }
+        bool IsRetired() const { return _retired.load(std::memory_order_acquire); }
+
+    private:
+        // Contiguous free bytes at the producer position, one byte always stays free so equal positions mean empty
+        std::size_t Free() const
+        {
+            if (_producerPos >= _cachedConsumerPos)
+                return _capacity - _producerPos;
+
+            return _cachedConsumerPos - _producerPos;
+        }
+
+        uint8* const _storage;
+        std::size_t const _capacity;
+        uint32 const _threadId;
+
+        // Producer
+        alignas(WARHEAD_CACHE_LINE_SIZE) std::size_t _producerPos{ 0 };
+        std::size_t _cachedConsumerPos{ 0 };
+
+        // Shared
+        alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<std::size_t> _producerPosShared{ 0 };
+        std::atomic<std::size_t> _endOfRecords{ 0 };
+        std::atomic<bool> _retired{ false };
+
+        // Consumer
+        alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<std::size_t> _consumerPos{ 0 };
+
+        StagingBuffer(StagingBuffer const&) = delete;
+        StagingBuffer& operator=(StagingBuffer const&) = delete;
+    };
+
+    // Receives formatted messages on the background thread when no binary file is used
+    using MessageHandler = std::function<void(CallSiteInfo const& site, int64 time, std::string_view message)>;
+
+    // Start the background thread. Messages are written unformatted to binaryFile if it is set, passed to handler otherwise.
+    // New threads get staging buffers of bufferSize bytes, full buffers block the logging thread if block is set
+    WH_COMMON_API bool Start(std::size_t bufferSize, bool block, std::string const& binaryFile, MessageHandler handler);
+
+    // Write out everything staged and stop the background thread
+    WH_COMMON_API void Stop();
+
+    // Messages lost since Start because a staging buffer was full
+    WH_COMMON_API uint64 GetDroppedCount();
+
+    WH_COMMON_API uint32 RegisterCallSite(CallSite& site, std::string_view filter, uint8 level, char const* file, int line, char const* function, std::string_view format);
+
+    // Staging buffer of the calling thread, created on first use
+    WH_COMMON_API StagingBuffer& GetStagingBuffer();
+
+    // Waits for room or gives up depending on the overflow policy. Null if the message is dropped
+    WH_COMMON_API uint8* ReserveSlow(StagingBuffer& buffer, std::size_t size);
+
+    // Format the args of a message record with format. Returns false if the args are malformed
+    WH_COMMON_API bool FormatMessage(std::string_view format, uint8 const* args, std::size_t size, std::string& message);
+
+    namespace Impl
+    {
+        // Arguments are reduced to the types a record can hold, anything else is formatted on the calling thread
+        template<typename T>
+        auto Normalize(T const& value)
+        {
+            using Type = std::decay_t<T>;
+
+            if constexpr (std::is_same_v<Type, bool> || std::is_same_v<Type, char>)
+                return value;
+            else if constexpr (std::is_integral_v<Type>)
+            {
+                if constexpr (std::is_signed_v<Type>)
+                    return static_cast<int64>(value);
+                else
+                    return static_cast<uint64>(value);
+            }
+            else if constexpr (std::is_floating_point_v<Type>)
+                return static_cast<double>(value);
+            else if constexpr (std::is_convertible_v<T const&, std::string_view>)
+                return std::string_view(value);
+            else if constexpr (std::is_pointer_v<Type>)
+                return static_cast<void const*>(value);
+            else
+                return fmt::format("{}", value);
+        }
+
+        template<typename T>
+        constexpr ArgType GetArgType()
+        {
+            if constexpr (std::is_same_v<T, bool>)
+                return ArgType::Bool;
+            else if constexpr (std::is_same_v<T, char>)
+                return ArgType::Char;
+            else if constexpr (std::is_same_v<T, int64>)
+                return ArgType::Int;
+            else if constexpr (std::is_same_v<T, uint64>)
+                return ArgType::UInt;
+            else if constexpr (std::is_same_v<T, double>)
+                return ArgType::Double;
+            else if constexpr (std::is_same_v<T, void const*>)
+                return ArgType::Pointer;
+            else
+                return ArgType::String;
+        }
+
+        template<typename T>
+        std::size_t GetArgSize(T const& value)
+        {
+            if constexpr (GetArgType<T>() == ArgType::String)
+                return sizeof(uint8) + sizeof(uint32) + std::string_view(value).size();
+            else
+                return sizeof(uint8) + sizeof(T);
+        }
+
+        template<typename T>
+        inline void Put(uint8*& out, T const& value)
+        {
+            std::memcpy(out, &value, sizeof(T));
+            out += sizeof(T);
+        }
+
+        template<typename T>
+        void PutArg(uint8*& out, T const& value)
+        {
+            Put(out, GetArgType<T>());
+
+            if constexpr (GetArgType<T>() == ArgType::String)
+            {
+                std::string_view string(value);
+                Put(out, static_cast<uint32>(string.size()));
+                std::memcpy(out, string.data(), string.size());
+                out += string.size();
+            }
+            else
+                Put(out, value);
+        }
+    }
+
+    template<typename... Args>
+    void Write(CallSite& site, std::string_view filter, uint8 level, char const* file, int line, char const* function, std::string_view format, Args const&... args)
+    {
+        uint32 id = site.Id.load(std::memory_order_acquire);
+        if (!id)
+            id = RegisterCallSite(site, filter, level, file, line, function, format);
+
+        auto normalized = std::make_tuple(Impl::Normalize(args)...);
+        std::size_t argsSize = std::apply([](auto const&... arg) { return (std::size_t(0) + ... + Impl::GetArgSize(arg)); }, normalized);
+        std::size_t size = MESSAGE_HEADER_SIZE + argsSize;
+
+        StagingBuffer& buffer = GetStagingBuffer();
+        uint8* out = buffer.Reserve(size);
+        if (!out && !(out = ReserveSlow(buffer, size)))
+            return;
+
+        Impl::Put(out, RecordType::Message);
+        Impl::Put(out, id);
+        Impl::Put(out, static_cast<uint32>(argsSize));
+        Impl::Put(out, static_cast<int64>(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count()));
+        Impl::Put(out, buffer.GetThreadId());
+        std::apply([&out](auto const&... arg) { (Impl::PutArg(out, arg), ...); }, normalized);
+
+        buffer.Commit(size);
+    }
+}
+
+#endif // _DEFERRED_LOG_H_
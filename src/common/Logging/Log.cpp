@@ -16,12 +16,15 @@
  */
 
 #include "Log.h"
+#include "AsyncLogger.h"
 #include "Config.h"
 #include "StringConvert.h"
 #include "Tokenize.h"
 #include <spdlog/spdlog.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 #include <spdlog/sinks/rotating_file_sink.h>
+#include <algorithm>
+#include <chrono>
 
 namespace
 {
@@ -34,6 +37,9 @@ namespace
     constexpr auto PREFIX_LOGGER_LENGTH = 7;
     constexpr auto PREFIX_SINK_LENGTH = 5;
 
+    // Window of the per call site rate limit
+    constexpr int64 RATE_LIMIT_WINDOW = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::seconds(1)).count();
+
     std::shared_ptr<spdlog::logger> GetLoggerByType(std::string_view type)
     {
         if (auto logger = spdlog::get(std::string(type)))
@@ -70,9 +76,38 @@ Log* Log::instance()
 
 void Log::Clear()
 {
+    // Staged messages are formatted to the loggers, stop before the loggers go away
+    _deferred.store(false, std::memory_order_relaxed);
+    Warhead::DeferredLog::Stop();
+
+    if (uint64 dropped = Warhead::DeferredLog::GetDroppedCount())
+        FMT_LOG_ERROR("Log::Clear - {} messages were dropped, deferred log buffer was full", dropped);
+
+    // Last chance to report suppressed messages, a call site may never log again
+    FlushSuppressed(false);
+
+    // Call sites resolve their loggers again, loggers they still use stay alive until the next reload
+    ResetCategories();
+    {
+        std::lock_guard<std::mutex> lock(_categoriesLock);
+        _retiredCategoryLoggers = std::move(_categoryLoggers);
+        _categoryLoggers.clear();
+        _rateLimits.clear();
+    }
+
     // Clear all loggers
     spdlog::shutdown();
 
+    // Writes out messages still queued, queued messages keep their loggers alive until then
+    if (_asyncQueue)
+    {
+        uint64 dropped = _asyncQueue->GetDroppedCount();
+        _asyncQueue.reset();
+
+        if (dropped)
+            FMT_LOG_ERROR("Log::Clear - {} messages were dropped, async log queue was full", dropped);
+    }
+
     // Clear sink list
     _sinkList.clear();
 }
@@ -88,8 +123,13 @@ void Log::LoadFromConfig()
 
     Clear();
     InitLogsDir();
+    InitAsyncQueue();
     ReadSinksFromConfig();
     ReadLoggersFromConfig();
+    InitDeferred();
+
+    // Categories resolved while loggers were created
+    ResetCategories();
 
     // Clear sink list
     _sinkList.clear();
@@ -104,6 +144,63 @@ void Log::InitLogsDir()
             m_logsDir.push_back('/');
 }
 
+void Log::InitAsyncQueue()
+{
+    if (!sConfigMgr->GetOption<bool>("Log.Async.Enable", false))
+        return;
+
+    auto queueSize = sConfigMgr->GetOption<uint32>("Log.Async.QueueSize", 8192);
+    if (!queueSize)
+    {
+        FMT_LOG_ERROR("Log::InitAsyncQueue - Log.Async.QueueSize can't be 0, set to 8192");
+        queueSize = 8192;
+    }
+
+    auto policy = sConfigMgr->GetOption<uint8>("Log.Async.OverflowPolicy", static_cast<uint8>(LogOverflowPolicy::Block));
+    if (policy >= static_cast<uint8>(LogOverflowPolicy::Max))
+    {
+        FMT_LOG_ERROR("Log::InitAsyncQueue - Wrong Log.Async.OverflowPolicy {}, set to 0 (block)", policy);
+        policy = static_cast<uint8>(LogOverflowPolicy::Block);
+    }
+
+    _asyncQueue = std::make_shared<AsyncLogQueue>(queueSize, static_cast<LogOverflowPolicy>(policy));
+}
+
+void Log::InitDeferred()
+{
+    if (!sConfigMgr->GetOption<bool>("Log.Deferred.Enable", false))
+        return;
+
+    auto bufferSize = sConfigMgr->GetOption<uint32>("Log.Deferred.BufferSize", 1048576);
+    if (bufferSize < 4096)
+    {
+        FMT_LOG_ERROR("Log::InitDeferred - Log.Deferred.BufferSize can't be less than 4096, set to 1048576");
+        bufferSize = 1048576;
+    }
+
+    // Per thread buffers have no oldest message to drop, any drop policy drops the new message
+    bool block = sConfigMgr->GetOption<uint8>("Log.Async.OverflowPolicy", static_cast<uint8>(LogOverflowPolicy::Block)) == static_cast<uint8>(LogOverflowPolicy::Block);
+
+    std::string binaryFile = sConfigMgr->GetOption<std::string>("Log.Deferred.BinaryFile", "");
+    if (!binaryFile.empty())
+        binaryFile = m_logsDir + binaryFile;
+
+    bool started = Warhead::DeferredLog::Start(bufferSize, block, binaryFile, [](Warhead::DeferredLog::CallSiteInfo const& site, int64 time, std::string_view message)
+    {
+        auto logger = GetLoggerByType(site.Filter);
+        if (!logger)
+            return;
+
+        spdlog::log_clock::time_point logTime(std::chrono::duration_cast<spdlog::log_clock::duration>(std::chrono::nanoseconds(time)));
+        logger->log(logTime, spdlog::source_loc{ site.File.c_str(), static_cast<int>(site.Line), site.Function.c_str() }, spdlog::level::level_enum(site.Level), message);
+    });
+
+    _deferred.store(started, std::memory_order_relaxed);
+
+    if (!started)
+        FMT_LOG_ERROR("Log::InitDeferred - Can't open binary log file '{}', deferred logging disabled", binaryFile);
+}
+
 void Log::ReadLoggersFromConfig()
 {
     auto const& keys = sConfigMgr->GetKeysByString(PREFIX_LOGGER);
@@ -144,9 +241,7 @@ std::string_view Log::GetPositionOptions(std::string_view options, uint8 positio
 
 bool Log::ShouldLog(std::string_view type, LogLevel level) const
 {
-    // TODO: Use cache to store "Type.sub1.sub2": "Type" equivalence, should
-    // Speed up in cases where requesting "Type.sub1.sub2" but only configured
-    // Logger "Type"
+    // Not cached, LOG_* macros resolve their category once per call site
 
     // Don't even look for a logger if the LogLevel is lower than lowest log levels across all loggers
     if (level < lowestLogLevel)
@@ -160,6 +255,123 @@ bool Log::ShouldLog(std::string_view type, LogLevel level) const
     return logLevel != LogLevel::Disabled && logLevel <= level;
 }
 
+bool Log::ShouldLog(LogCategory& category, std::string_view type, LogLevel level)
+{
+    if (!category.Resolved.load(std::memory_order_acquire))
+        ResolveCategory(category, type);
+
+    return category.MayLog(level);
+}
+
+void Log::ResolveCategory(LogCategory& category, std::string_view type)
+{
+    std::lock_guard<std::mutex> lock(_categoriesLock);
+
+    // Other thread got here first
+    if (category.Resolved.load(std::memory_order_relaxed))
+        return;
+
+    if (!category.Registered.exchange(true, std::memory_order_relaxed))
+        _categories.push_back(&category);
+
+    LogLevel threshold = LogLevel::Disabled;
+
+    auto logger = GetLoggerByType(type);
+    if (logger)
+    {
+        threshold = LogLevel(logger->level());
+
+        if (std::find(_categoryLoggers.begin(), _categoryLoggers.end(), logger) == _categoryLoggers.end())
+            _categoryLoggers.emplace_back(logger);
+    }
+
+    uint32 rateLimit = 0;
+    if (logger)
+        if (auto itr = _rateLimits.find(logger->name()); itr != _rateLimits.end())
+            rateLimit = itr->second;
+
+    category.Logger.store(logger.get(), std::memory_order_relaxed);
+    category.RateLimit.store(rateLimit, std::memory_order_relaxed);
+    category.Threshold.store(static_cast<uint8>(threshold), std::memory_order_relaxed);
+    category.Resolved.store(true, std::memory_order_release);
+}
+
+void Log::ResetCategories()
+{
+    std::lock_guard<std::mutex> lock(_categoriesLock);
+
+    for (LogCategory* category : _categories)
+    {
+        category->Resolved.store(false, std::memory_order_relaxed);
+        category->Logger.store(nullptr, std::memory_order_relaxed);
+        category->RateLimit.store(0, std::memory_order_relaxed);
+        category->Threshold.store(0, std::memory_order_release);
+    }
+}
+
+bool Log::PassRateLimit(LogCategory& category, LogLevel level, const char* file, int line, const char* function)
+{
+    int64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    int64 windowStart = category.WindowStart.load(std::memory_order_relaxed);
+
+    // One thread opens the new window, messages other threads count against the old one meanwhile are lost in the noise
+    if (now - windowStart >= RATE_LIMIT_WINDOW && category.WindowStart.compare_exchange_strong(windowStart, now, std::memory_order_relaxed))
+    {
+        category.WindowCount.store(1, std::memory_order_relaxed);
+
+        if (uint32 suppressed = category.Suppressed.exchange(0, std::memory_order_relaxed))
+            ReportSuppressed(category, level, file, line, function, suppressed);
+
+        return true;
+    }
+
+    if (category.WindowCount.fetch_add(1, std::memory_order_relaxed) < category.RateLimit.load(std::memory_order_relaxed))
+        return true;
+
+    if (!category.File.load(std::memory_order_relaxed))
+    {
+        category.Function.store(function, std::memory_order_relaxed);
+        category.Line.store(line, std::memory_order_relaxed);
+        category.Level.store(static_cast<uint8>(level), std::memory_order_relaxed);
+        category.File.store(file, std::memory_order_release);
+    }
+
+    category.Suppressed.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+void Log::ReportSuppressed(LogCategory& category, LogLevel level, const char* file, int line, const char* function, uint32 suppressed)
+{
+    spdlog::logger* logger = category.Logger.load(std::memory_order_acquire);
+    if (!logger)
+        return;
+
+    logger->log(spdlog::source_loc{ file, line, function }, spdlog::level::level_enum(level),
+        fmt::format("> Suppressed {} similar messages, rate limit of {} per second at {}:{}", suppressed, category.RateLimit.load(std::memory_order_relaxed), file, line));
+}
+
+void Log::FlushSuppressed(bool expiredOnly)
+{
+    int64 now = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+
+    std::lock_guard<std::mutex> lock(_categoriesLock);
+
+    for (LogCategory* category : _categories)
+    {
+        char const* file = category->File.load(std::memory_order_acquire);
+        if (!file)
+            continue;
+
+        // Suppressed count of the current window is reported by the message opening the next one
+        if (expiredOnly && now - category->WindowStart.load(std::memory_order_relaxed) < RATE_LIMIT_WINDOW)
+            continue;
+
+        if (uint32 suppressed = category->Suppressed.exchange(0, std::memory_order_relaxed))
+            ReportSuppressed(*category, LogLevel(category->Level.load(std::memory_order_relaxed)), file, category->Line.load(std::memory_order_relaxed),
+                category->Function.load(std::memory_order_relaxed), suppressed);
+    }
+}
+
 std::string const Log::GetChannelsFromLogger(std::string const& loggerName)
 {
     std::string const& loggerOptions = sConfigMgr->GetOption<std::string>(PREFIX_LOGGER + loggerName, "2, Console Server", false);
@@ -185,8 +397,9 @@ void Log::CreateLoggerFromConfig(std::string const& configLoggerName)
         return;
     }
 
+    // Rate limit is optional
     auto const& tokens = Warhead::Tokenize(options, ',', true);
-    if (!tokens.size() || tokens.size() < static_cast<size_t>(LoggerOptions::Max))
+    if (tokens.size() < static_cast<size_t>(LoggerOptions::RateLimit) || tokens.size() > static_cast<size_t>(LoggerOptions::Max))
     {
         FMT_LOG_ERROR("Log::CreateLoggerFromConfig: Bad config options for Logger ({})", loggerName);
         return;
@@ -202,6 +415,19 @@ void Log::CreateLoggerFromConfig(std::string const& configLoggerName)
     if (level < lowestLogLevel)
         lowestLogLevel = level;
 
+    auto rateLimit = Warhead::StringTo<uint32>(GetPositionOptions(options, LoggerOptions::RateLimit, "0"));
+    if (!rateLimit)
+    {
+        FMT_LOG_ERROR("Log::CreateLoggerFromConfig: Wrong rate limit for logger {}", loggerName);
+        return;
+    }
+
+    if (*rateLimit)
+    {
+        std::lock_guard<std::mutex> lock(_categoriesLock);
+        _rateLimits[loggerName] = *rateLimit;
+    }
+
     std::vector<spdlog::sink_ptr> sinkList;
 
     auto const& sinksName = GetPositionOptions(options, LoggerOptions::SinkName);
@@ -217,9 +443,16 @@ void Log::CreateLoggerFromConfig(std::string const& configLoggerName)
 
     try
     {
-        auto logger = std::make_shared<spdlog::logger>(loggerName);
+        std::shared_ptr<spdlog::logger> logger;
+        if (_asyncQueue)
+            logger = std::make_shared<AsyncLogger>(loggerName, std::move(sinkList), _asyncQueue);
+        else
+        {
+            logger = std::make_shared<spdlog::logger>(loggerName);
+            logger->sinks().swap(sinkList);
+        }
+
         logger->set_level(static_cast<spdlog::level::level_enum>(level));
-        logger->sinks().swap(sinkList);
         logger->flush_on(spdlog::level::level_enum(LogLevel::Error));
         spdlog::register_logger(logger);
     }
@@ -354,6 +587,15 @@ void Log::Write(std::string_view filter, LogLevel const level, const char* file,
     logger->log(spdlog::source_loc{ file, line, function }, spdlog::level::level_enum(level), message);
 }
 
+void Log::Write(LogCategory& category, LogLevel const level, const char* file, int line, const char* function, std::string_view message)
+{
+    spdlog::logger* logger = category.Logger.load(std::memory_order_acquire);
+    if (!logger)
+        return;
+
+    logger->log(spdlog::source_loc{ file, line, function }, spdlog::level::level_enum(level), message);
+}
+
 void Log::AddSink(std::string const& sinkName, std::shared_ptr<spdlog::sinks::sink> sink)
 {
     auto const& itr = _sinkList.find(sinkName);
@@ -19,15 +19,26 @@
 #define _LOG_H_
 
 #include "Define.h"
+#include "DeferredLog.h"
+#include <atomic>
+#include <mutex>
 #include <unordered_map>
+#include <vector>
 #include <fmt/format.h>
 #include <fmt/color.h>
 
+namespace spdlog
+{
+    class logger;
+}
+
 namespace spdlog::sinks
 {
     class sink;
 }
 
+class AsyncLogQueue;
+
 enum class LogLevel : uint8
 {
     Trace,
@@ -86,10 +97,37 @@ enum class LoggerOptions : uint8
 {
     LogLevel,
     SinkName,
+    RateLimit,
 
     Max
 };
 
+// Logger and level of one LOG_* call site, resolved on first use and again after the config is reloaded.
+// Trivially destructible, so a function local static needs no guard check
+struct LogCategory
+{
+    // Levels below are not logged. Trace until resolved, a message of any level resolves the category
+    std::atomic<uint8> Threshold{ 0 };
+    std::atomic<bool> Resolved{ false };
+    std::atomic<bool> Registered{ false };
+    std::atomic<spdlog::logger*> Logger{ nullptr };
+
+    // Messages per second the call site may write, 0 is unlimited. Taken from the logger when resolved
+    std::atomic<uint32> RateLimit{ 0 };
+    std::atomic<int64> WindowStart{ 0 };
+    std::atomic<uint32> WindowCount{ 0 };
+    std::atomic<uint32> Suppressed{ 0 };
+
+    // Call site location, kept to report suppressed messages when the config is reloaded
+    std::atomic<char const*> File{ nullptr };
+    std::atomic<char const*> Function{ nullptr };
+    std::atomic<int32> Line{ 0 };
+    std::atomic<uint8> Level{ 0 };
+
+    bool MayLog(LogLevel level) const { return static_cast<uint8>(level) >= Threshold.load(std::memory_order_relaxed); }
+    bool HasRateLimit() const { return RateLimit.load(std::memory_order_relaxed) != 0; }
+};
+
 class WH_COMMON_API Log
 {
 private:
@@ -108,14 +146,41 @@ public:
 
     bool ShouldLog(std::string_view type, LogLevel level) const;
 
+    // Slow path of the LOG_* macros, only reached when category.MayLog(level) is true
+    bool ShouldLog(LogCategory& category, std::string_view type, LogLevel level);
+
+    // Counts the message against the rate limit of its call site, false if it is suppressed.
+    // First message of a new window reports how many messages the previous windows suppressed
+    bool PassRateLimit(LogCategory& category, LogLevel level, const char* file, int line, const char* function);
+
+    // Reports messages suppressed in rate limit windows that ended without a message opening the next one.
+    // A call site going quiet after a burst reports them at its next message otherwise. Call about once per second
+    void FlushExpiredSuppressed() { FlushSuppressed(true); }
+
+    // Log.Deferred.Enable is set, LOG_* macros stage raw arguments for the background thread.
+    // Relaxed, a thread seeing the old value around a reload only stages to or skips a buffer of the stopped registry
+    bool IsDeferred() const { return _deferred.load(std::memory_order_relaxed); }
+
     template<typename... Args>
     inline void outMessage(std::string const& filter, LogLevel const level, const char* file, int line, const char* function, std::string_view fmt, Args&&... args)
     {
         Write(filter, level, file, line, function, fmt::format(fmt, std::forward<Args>(args)...));
     }
 
+    template<typename... Args>
+    inline void outMessage(LogCategory& category, LogLevel const level, const char* file, int line, const char* function, std::string_view fmt, Args&&... args)
+    {
+        Write(category, level, file, line, function, fmt::format(fmt, std::forward<Args>(args)...));
+    }
+
 private:
     void Write(std::string_view filter, LogLevel const level, const char* file, int line, const char* function, std::string_view message);
+    void Write(LogCategory& category, LogLevel const level, const char* file, int line, const char* function, std::string_view message);
+
+    void ResolveCategory(LogCategory& category, std::string_view type);
+    void ResetCategories();
+    void ReportSuppressed(LogCategory& category, LogLevel level, const char* file, int line, const char* function, uint32 suppressed);
+    void FlushSuppressed(bool expiredOnly);
 
     void CreateLoggerFromConfig(std::string const& configLoggerName);
     void CreateSinksFromConfig(std::string const& loggerSinkName);
@@ -123,6 +188,8 @@ private:
     void ReadSinksFromConfig();
 
     void InitLogsDir();
+    void InitAsyncQueue();
+    void InitDeferred();
     void Clear();
     uint16 GetColorCode(std::string_view colorName);
 
@@ -152,15 +219,43 @@ private:
     std::shared_ptr<spdlog::sinks::sink> GetSink(std::string const& sinkName);
 
     std::unordered_map<std::string, std::shared_ptr<spdlog::sinks::sink>> _sinkList;
+
+    // Shared by all loggers when Log.Async.Enable is set, null otherwise
+    std::shared_ptr<AsyncLogQueue> _asyncQueue;
+
+    // Read by every LOG_* statement on any thread, written by Clear and InitDeferred
+    std::atomic<bool> _deferred{ false };
+
+    std::mutex _categoriesLock;
+    std::vector<LogCategory*> _categories;
+    // Loggers categories point to. Kept for one more reload, a call site may still use its logger while the config is reloaded
+    std::vector<std::shared_ptr<spdlog::logger>> _categoryLoggers;
+    std::vector<std::shared_ptr<spdlog::logger>> _retiredCategoryLoggers;
+    // Rate limit of every logger that has one, by logger name
+    std::unordered_map<std::string, uint32> _rateLimits;
 };
 
 #define sLog Log::instance()
 
-#define LOG_EXCEPTION_FREE(filterType__, level__, ...) \
+#define LOG_EXCEPTION_FREE(category__, level__, ...) \
+    { \
+        try \
+        { \
+            sLog->outMessage(category__, level__, __FILE__, __LINE__, static_cast<const char *>(__FUNCTION__), fmt::format(__VA_ARGS__)); \
+        } \
+        catch (const std::exception& e) \
+        { \
+            sLog->outMessage("server", LogLevel::Error, __FILE__, __LINE__, static_cast<const char *>(__FUNCTION__), "Wrong format occurred ({}) at '{}:{}'", \
+                e.what(), __FILE__, __LINE__); \
+        } \
+    }
+
+#define LOG_DEFERRED(filterType__, level__, ...) \
     { \
+        static Warhead::DeferredLog::CallSite callSite__; \
         try \
         { \
-            sLog->outMessage(filterType__, level__, __FILE__, __LINE__, static_cast<const char *>(__FUNCTION__), fmt::format(__VA_ARGS__)); \
+            Warhead::DeferredLog::Write(callSite__, filterType__, static_cast<uint8>(level__), __FILE__, __LINE__, static_cast<const char *>(__FUNCTION__), __VA_ARGS__); \
         } \
         catch (const std::exception& e) \
         { \
@@ -169,29 +264,87 @@ private:
         } \
     }
 
-#define LOG_MSG_BODY(filterType__, level__, ...)                        \
-        do {                                                            \
-            if (sLog->ShouldLog(filterType__, level__))                 \
-                LOG_EXCEPTION_FREE(filterType__, level__, __VA_ARGS__); \
+#define LOG_MSG_BODY(filterType__, level__, ...)                                    \
+        do {                                                                        \
+            static LogCategory logCategory__;                                       \
+            if (logCategory__.MayLog(level__) &&                                    \
+                sLog->ShouldLog(logCategory__, filterType__, level__) &&            \
+                (!logCategory__.HasRateLimit() ||                                   \
+                 sLog->PassRateLimit(logCategory__, level__, __FILE__, __LINE__,    \
+                    static_cast<const char *>(__FUNCTION__))))                      \
+            {                                                                       \
+                if (sLog->IsDeferred())                                             \
+                    LOG_DEFERRED(filterType__, level__, __VA_ARGS__)                \
+                else                                                                \
+                    LOG_EXCEPTION_FREE(logCategory__, level__, __VA_ARGS__)         \
+            }                                                                       \
         } while (0)
 
+// Levels below WARHEAD_LOG_LEVEL_FLOOR are removed by the preprocessor, LOG_* statements of those levels
+// evaluate no arguments and generate no code. Their arguments still appear in an unevaluated sizeof, so variables
+// only logged don't turn into unused variable warnings. Code that only feeds such statements checks LOG_LEVEL_COMPILED
+#ifndef WARHEAD_LOG_LEVEL_FLOOR
+#define WARHEAD_LOG_LEVEL_FLOOR 0
+#endif
+
+#define WARHEAD_LOG_LEVEL_TRACE    0
+#define WARHEAD_LOG_LEVEL_DEBUG    1
+#define WARHEAD_LOG_LEVEL_INFO     2
+#define WARHEAD_LOG_LEVEL_WARNING  3
+#define WARHEAD_LOG_LEVEL_ERROR    4
+#define WARHEAD_LOG_LEVEL_CRITICAL 5
+
+static_assert(WARHEAD_LOG_LEVEL_TRACE == static_cast<int>(LogLevel::Trace) && WARHEAD_LOG_LEVEL_CRITICAL == static_cast<int>(LogLevel::Critical));
+
+#define LOG_LEVEL_COMPILED(level__) (WARHEAD_LOG_LEVEL_FLOOR <= WARHEAD_LOG_LEVEL_##level__)
+
+template<typename... Args>
+inline bool LogCompiledOut(Args const&... /*args*/) { return false; }
+
+#define LOG_COMPILED_OUT(filterType__, ...) \
+        do { (void)sizeof(LogCompiledOut(filterType__, __VA_ARGS__)); } while (0)
+
+#if LOG_LEVEL_COMPILED(CRITICAL)
 #define LOG_CRIT(filterType__, ...) \
     LOG_MSG_BODY(filterType__, LogLevel::Critical, __VA_ARGS__)
+#else
+#define LOG_CRIT(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
+#if LOG_LEVEL_COMPILED(ERROR)
 #define LOG_ERROR(filterType__, ...) \
     LOG_MSG_BODY(filterType__, LogLevel::Error, __VA_ARGS__)
+#else
+#define LOG_ERROR(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
+#if LOG_LEVEL_COMPILED(WARNING)
 #define LOG_WARN(filterType__, ...)  \
     LOG_MSG_BODY(filterType__, LogLevel::Warning, __VA_ARGS__)
+#else
+#define LOG_WARN(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
+#if LOG_LEVEL_COMPILED(INFO)
 #define LOG_INFO(filterType__, ...)  \
     LOG_MSG_BODY(filterType__, LogLevel::Info, __VA_ARGS__)
+#else
+#define LOG_INFO(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
+#if LOG_LEVEL_COMPILED(DEBUG)
 #define LOG_DEBUG(filterType__, ...) \
     LOG_MSG_BODY(filterType__, LogLevel::Debug, __VA_ARGS__)
+#else
+#define LOG_DEBUG(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
+#if LOG_LEVEL_COMPILED(TRACE)
 #define LOG_TRACE(filterType__, ...) \
     LOG_MSG_BODY(filterType__, LogLevel::Trace, __VA_ARGS__)
+#else
+#define LOG_TRACE(filterType__, ...) LOG_COMPILED_OUT(filterType__, __VA_ARGS__)
+#endif
 
 #define FMT_LOG_INFO(...) \
     fmt::print(fmt::emphasis::bold | fg(fmt::color::cyan), fmt::format(__VA_ARGS__) + "\n");
@@ -0,0 +1,102 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AtomicWait.h"
+
+// futex is Linux only, WARHEAD_PLATFORM_UNIX also covers the BSDs
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+#include <climits>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#endif
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+namespace
+{
+    static_assert(sizeof(std::atomic<uint32>) == sizeof(uint32), "futex needs a plain 32 bit word");
+
+    long Futex(std::atomic<uint32>& value, int op, uint32 arg)
+    {
+        return syscall(SYS_futex, reinterpret_cast<uint32*>(&value), op | FUTEX_PRIVATE_FLAG, arg, nullptr, nullptr, 0);
+    }
+}
+
+void Warhead::Thread::AtomicWait(std::atomic<uint32>& value, uint32 old)
+{
+    // Kernel compares value with old under its own lock, a notify between our check and the sleep is not lost
+    if (value.load(std::memory_order_acquire) == old)
+        Futex(value, FUTEX_WAIT, old);
+}
+
+void Warhead::Thread::AtomicNotifyOne(std::atomic<uint32>& value)
+{
+    Futex(value, FUTEX_WAKE, 1);
+}
+
+void Warhead::Thread::AtomicNotifyAll(std::atomic<uint32>& value)
+{
+    Futex(value, FUTEX_WAKE, INT_MAX);
+}
+#else
+namespace
+{
+    // Waiters on different atomics may share a bucket, notify wakes all of them and they check their value again
+    struct WaitBucket
+    {
+        std::mutex Lock;
+        std::condition_variable Condition;
+    };
+
+    WaitBucket& GetWaitBucket(std::atomic<uint32> const& value)
+    {
+        static WaitBucket buckets[64];
+        return buckets[(reinterpret_cast<std::uintptr_t>(&value) >> 4) % 64];
+    }
+}
+
+void Warhead::Thread::AtomicWait(std::atomic<uint32>& value, uint32 old)
+{
+    WaitBucket& bucket = GetWaitBucket(value);
+
+    std::unique_lock<std::mutex> lock(bucket.Lock);
+    if (value.load(std::memory_order_acquire) == old)
+        bucket.Condition.wait(lock);
+}
+
+void Warhead::Thread::AtomicNotifyOne(std::atomic<uint32>& value)
+{
+    // Bucket is shared, waking a single thread could wake a waiter of another atomic
+    AtomicNotifyAll(value);
+}
+
+void Warhead::Thread::AtomicNotifyAll(std::atomic<uint32>& value)
+{
+    WaitBucket& bucket = GetWaitBucket(value);
+
+    // Lock orders the notify after a waiter that already checked the value but is not asleep yet
+    {
+        std::lock_guard<std::mutex> lock(bucket.Lock);
+    }
+
+    bucket.Condition.notify_all();
+}
+#endif
@@ -0,0 +1,49 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ATOMIC_WAIT_H_
+#define _ATOMIC_WAIT_H_
+
+#include "Define.h"
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h>
+#endif
+
+// C++17 stand-in for std::atomic<uint32>::wait/notify_one/notify_all of C++20.
+// Linux uses the futex syscall on the atomic itself, other platforms (BSDs included) a table of condition variables keyed by address
+namespace Warhead::Thread
+{
+    // Blocks while value == old. May return spuriously, callers check their condition again
+    WH_COMMON_API void AtomicWait(std::atomic<uint32>& value, uint32 old);
+
+    WH_COMMON_API void AtomicNotifyOne(std::atomic<uint32>& value);
+    WH_COMMON_API void AtomicNotifyAll(std::atomic<uint32>& value);
+
+    // Hint for spin loops, lets the sibling hyper-thread run
+    inline void CpuRelax()
+    {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+        _mm_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield");
+#endif
+    }
+}
+
+#endif // _ATOMIC_WAIT_H_
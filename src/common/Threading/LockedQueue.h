@@ -19,7 +19,9 @@
 #define LOCKEDQUEUE_H
 
 #include <deque>
+#include <iterator>
 #include <mutex>
+#include <utility>
 
 template <class T, typename StorageType = std::deque<T>>
 class LockedQueue
@@ -75,6 +77,31 @@ public:
         return true;
     }
 
+    //! Moves all items of the queue to the back of result with a single lock acquisition.
+    //! An empty result is swapped with the storage instead of moving the items one by one, the queue then continues
+    //! with the container result held before.
+    bool drain(StorageType& result)
+    {
+        std::lock_guard<std::mutex> lock(_lock);
+
+        if (_queue.empty())
+        {
+            return false;
+        }
+
+        if (result.empty())
+        {
+            std::swap(result, _queue);
+        }
+        else
+        {
+            result.insert(result.end(), std::make_move_iterator(_queue.begin()), std::make_move_iterator(_queue.end()));
+            _queue.clear();
+        }
+
+        return true;
+    }
+
     template<class Checker>
     bool next(T& result, Checker& check)
     {
@@ -0,0 +1,318 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MPMCQueue_h__
+#define MPMCQueue_h__
+
+#include "AtomicWait.h"
+#include "Define.h"
+#include "Errors.h"
+#include <atomic>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+
+namespace Warhead
+{
+// C++ implementation of Dmitry Vyukov's bounded MPMC queue
+// http://www.1024cores.net/home/lock-free-algorithms/queues/bounded-mpmc-queue
+// Every slot carries a sequence number telling whether it is free for the producer or filled for the consumer of a
+// given lap, producers and consumers only contend on their own position counter. Elements are moved in and out.
+// Blocking calls spin first and sleep on a futex only when the queue stays full or empty, Cancel wakes all of them
+template<typename T>
+class MPMCQueue
+{
+public:
+    explicit MPMCQueue(std::size_t capacity) : _mask(RoundUpToPowerOfTwo(capacity) - 1), _cells(std::make_unique<Cell[]>(_mask + 1))
+    {
+        ASSERT(capacity > 0);
+
+        for (std::size_t i = 0; i <= _mask; ++i)
+            _cells[i].Sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~MPMCQueue()
+    {
+        DeleteQueuedObjects();
+    }
+
+    // Returns false if the queue is full or cancelled
+    template<typename... Args>
+    bool TryEmplace(Args&&... args)
+    {
+        if (_cancelled.load(std::memory_order_relaxed))
+            return false;
+
+        if (!TryEmplaceInternal(std::forward<Args>(args)...))
+            return false;
+
+        DeleteIfCancelled();
+        Notify(_popSide);
+        return true;
+    }
+
+    bool TryPush(T&& value) { return TryEmplace(std::move(value)); }
+
+    // Waits while the queue is full. Returns false if the queue is cancelled, value is left untouched then
+    bool Push(T&& value)
+    {
+        if (!Wait(_pushSide, [&]() { return TryEmplaceInternal(std::move(value)); }))
+            return false;
+
+        DeleteIfCancelled();
+        Notify(_popSide);
+        return true;
+    }
+
+    // Returns false if the queue is empty or cancelled
+    bool TryPop(T& value)
+    {
+        if (_cancelled.load(std::memory_order_relaxed) || !TryPopInternal(value))
+            return false;
+
+        Notify(_pushSide);
+        return true;
+    }
+
+    // Waits while the queue is empty. Returns false if the queue is cancelled
+    bool WaitAndPop(T& value)
+    {
+        if (!Wait(_popSide, [&]() { return TryPopInternal(value); }))
+            return false;
+
+        Notify(_pushSide);
+        return true;
+    }
+
+    // Fails pending and future calls, queued elements are destroyed
+    void Cancel()
+    {
+        _cancelled.store(true, std::memory_order_seq_cst);
+
+        // Pairs with the fence in DeleteIfCancelled
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        DeleteQueuedObjects();
+
+        for (WaitSide* side : { &_pushSide, &_popSide })
+        {
+            side->Epoch.fetch_add(2, std::memory_order_seq_cst);
+            Thread::AtomicNotifyAll(side->Epoch);
+        }
+    }
+
+    bool IsCancelled() const { return _cancelled.load(std::memory_order_relaxed); }
+
+    // Approximate when called while other threads push or pop
+    std::size_t Size() const
+    {
+        std::size_t enqueuePos = _enqueuePos.load(std::memory_order_acquire);
+        std::size_t dequeuePos = _dequeuePos.load(std::memory_order_acquire);
+        return enqueuePos > dequeuePos ? enqueuePos - dequeuePos : 0;
+    }
+
+    bool Empty() const { return Size() == 0; }
+    std::size_t Capacity() const { return _mask + 1; }
+
+private:
+    // Tries before a blocking call goes to sleep. Spinning on a single cpu only delays the thread we wait for
+    static uint32 GetSpinCount()
+    {
+        static uint32 const spinCount = std::thread::hardware_concurrency() > 1 ? 128 : 0;
+        return spinCount;
+    }
+
+    struct alignas(WARHEAD_CACHE_LINE_SIZE) Cell
+    {
+        std::atomic<std::size_t> Sequence;
+        std::aligned_storage_t<sizeof(T), alignof(T)> Data;
+
+        T* Get() { return std::launder(reinterpret_cast<T*>(&Data)); }
+    };
+
+    // Threads sleeping in Push (queue full) or WaitAndPop (queue empty), futex word of an event count.
+    // Lowest bit is set by threads going to sleep, the other bits count wakeups. Notify only makes a syscall
+    // if the bit is set and clears it, so a burst of pushes wakes sleeping consumers once
+    struct alignas(WARHEAD_CACHE_LINE_SIZE) WaitSide
+    {
+        std::atomic<uint32> Epoch{ 0 };
+    };
+
+    static constexpr uint32 SLEEPERS_FLAG = 1;
+
+    void DeleteQueuedObjects()
+    {
+        while (TryConsume([this](T&& value) { DeleteQueuedObject(value); }))
+            ;
+    }
+
+    // A push that passed the cancelled check may publish its element after the drain in Cancel. Either Cancel
+    // sees the element or the pusher sees the flag, the element counts as pushed and is destroyed with the others
+    void DeleteIfCancelled()
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (_cancelled.load(std::memory_order_relaxed))
+            DeleteQueuedObjects();
+    }
+
+    template<typename... Args>
+    bool TryEmplaceInternal(Args&&... args)
+    {
+        std::size_t pos = _enqueuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = std::intptr_t(sequence) - std::intptr_t(pos);
+
+            if (diff == 0)
+            {
+                if (_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    new (&cell.Data) T(std::forward<Args>(args)...);
+                    cell.Sequence.store(pos + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // Full, slot still holds the element of the previous lap
+            else
+                pos = _enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    bool TryPopInternal(T& value)
+    {
+        return TryConsume([&value](T&& element) { value = std::move(element); });
+    }
+
+    // Passes the element to consume as rvalue and destroys it afterwards
+    template<typename Consume>
+    bool TryConsume(Consume&& consume)
+    {
+        std::size_t pos = _dequeuePos.load(std::memory_order_relaxed);
+
+        for (;;)
+        {
+            Cell& cell = _cells[pos & _mask];
+            std::size_t sequence = cell.Sequence.load(std::memory_order_acquire);
+            std::intptr_t diff = std::intptr_t(sequence) - std::intptr_t(pos + 1);
+
+            if (diff == 0)
+            {
+                if (_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                {
+                    T* data = cell.Get();
+                    consume(std::move(*data));
+                    data->~T();
+                    cell.Sequence.store(pos + _mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0)
+                return false; // Empty, producer of this lap did not publish yet
+            else
+                pos = _dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    template<typename Try>
+    bool Wait(WaitSide& side, Try&& tryOnce)
+    {
+        for (;;)
+        {
+            for (uint32 i = 0, spinCount = GetSpinCount(); i < spinCount; ++i)
+            {
+                if (_cancelled.load(std::memory_order_relaxed))
+                    return false;
+
+                if (tryOnce())
+                    return true;
+
+                Thread::CpuRelax();
+            }
+
+            if (_cancelled.load(std::memory_order_relaxed))
+                return false;
+
+            if (tryOnce())
+                return true;
+
+            uint32 epoch = side.Epoch.fetch_or(SLEEPERS_FLAG, std::memory_order_seq_cst) | SLEEPERS_FLAG;
+
+            // Pairs with the fence in Notify: either we see the new element (or free slot), or the other side sees the flag
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+
+            if (_cancelled.load(std::memory_order_relaxed))
+                return false;
+
+            if (tryOnce())
+                return true;
+
+            Thread::AtomicWait(side.Epoch, epoch);
+        }
+    }
+
+    void Notify(WaitSide& side)
+    {
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        // No syscall while nobody sleeps
+        uint32 epoch = side.Epoch.load(std::memory_order_relaxed);
+        if (!(epoch & SLEEPERS_FLAG))
+            return;
+
+        // Woken threads set the flag again if they find nothing, all of them have to check
+        if (side.Epoch.compare_exchange_strong(epoch, (epoch + 2) & ~SLEEPERS_FLAG, std::memory_order_release, std::memory_order_relaxed))
+            Thread::AtomicNotifyAll(side.Epoch);
+    }
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value)
+            result <<= 1;
+
+        return result;
+    }
+
+    template<typename E = T>
+    typename std::enable_if<std::is_pointer<E>::value>::type DeleteQueuedObject(E& obj) { delete obj; }
+
+    template<typename E = T>
+    typename std::enable_if<!std::is_pointer<E>::value>::type DeleteQueuedObject(E const& /*obj*/) { }
+
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<std::size_t> _enqueuePos{ 0 };
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<std::size_t> _dequeuePos{ 0 };
+
+    WaitSide _pushSide;
+    WaitSide _popSide;
+
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<bool> _cancelled{ false };
+    std::size_t const _mask;
+    std::unique_ptr<Cell[]> const _cells;
+
+    MPMCQueue(MPMCQueue const&) = delete;
+    MPMCQueue& operator=(MPMCQueue const&) = delete;
+};
+}
+
+#endif // MPMCQueue_h__
@@ -28,7 +28,10 @@ namespace Impl
 {
 // C++ implementation of Dmitry Vyukov's lock free MPSC queue
 // http://www.1024cores.net/home/lock-free-algorithms/queues/non-intrusive-mpsc-node-based-queue
-template<typename T>
+// With RecycleNodes the consumer pushes dequeued nodes to a lock free free list instead of deleting them.
+// Producers keep a thread local cache of nodes and refill it by taking the whole free list at once,
+// so steady state Enqueue/Dequeue don't touch the allocator
+template<typename T, bool RecycleNodes = false>
 class MPSCQueueNonIntrusive
 {
 public:
@@ -46,11 +49,14 @@ public:
 
         Node* front = _head.load(std::memory_order_relaxed);
         delete front;
+
+        if constexpr (RecycleNodes)
+            DeleteNodeList(_freeNodes.load(std::memory_order_acquire));
     }
 
     void Enqueue(T* input)
     {
-        Node* node = new Node(input);
+        Node* node = AllocateNode(input);
         Node* prevHead = _head.exchange(node, std::memory_order_acq_rel);
         prevHead->Next.store(node, std::memory_order_release);
     }
@@ -64,7 +70,7 @@ public:
 
         result = next->Data;
         _tail.store(next, std::memory_order_release);
-        delete tail;
+        FreeNode(tail);
         return true;
     }
 
@@ -81,9 +87,71 @@ private:
         std::atomic<Node*> Next;
     };
 
+    // Nodes are not bound to a queue instance, a producer may reuse nodes of any queue of the same type
+    struct NodeCache
+    {
+        ~NodeCache() { DeleteNodeList(Nodes); }
+
+        Node* Nodes = nullptr;
+    };
+
+    static NodeCache& GetNodeCache()
+    {
+        thread_local NodeCache cache;
+        return cache;
+    }
+
+    static void DeleteNodeList(Node* node)
+    {
+        while (node)
+        {
+            Node* next = node->Next.load(std::memory_order_relaxed);
+            delete node;
+            node = next;
+        }
+    }
+
+    Node* AllocateNode(T* input)
+    {
+        if constexpr (RecycleNodes)
+        {
+            NodeCache& cache = GetNodeCache();
+
+            // Taking the whole list with exchange is immune to ABA, unlike popping single nodes with compare exchange
+            if (!cache.Nodes)
+                cache.Nodes = _freeNodes.exchange(nullptr, std::memory_order_acquire);
+
+            if (Node* node = cache.Nodes)
+            {
+                cache.Nodes = node->Next.load(std::memory_order_relaxed);
+                node->Data = input;
+                node->Next.store(nullptr, std::memory_order_relaxed);
+                return node;
+            }
+        }
+
+        return new Node(input);
+    }
+
+    void FreeNode(Node* node)
+    {
+        if constexpr (RecycleNodes)
+        {
+            Node* freeHead = _freeNodes.load(std::memory_order_relaxed);
+            do
+                node->Next.store(freeHead, std::memory_order_relaxed);
+            while (!_freeNodes.compare_exchange_weak(freeHead, node, std::memory_order_release, std::memory_order_relaxed));
+        }
+        else
+            delete node;
+    }
+
     std::atomic<Node*> _head;
     std::atomic<Node*> _tail;
 
+    // Only used with RecycleNodes, the consumer is the only thread pushing to it
+    std::atomic<Node*> _freeNodes{ nullptr };
+
     MPSCQueueNonIntrusive(MPSCQueueNonIntrusive const&) = delete;
     MPSCQueueNonIntrusive& operator=(MPSCQueueNonIntrusive const&) = delete;
 };
@@ -167,4 +235,8 @@ private:
 template<typename T, std::atomic<T*> T::* IntrusiveLink = nullptr>
 using MPSCQueue = std::conditional_t<IntrusiveLink != nullptr, Warhead::Impl::MPSCQueueIntrusive<T, IntrusiveLink>, Warhead::Impl::MPSCQueueNonIntrusive<T>>;
 
+// Non intrusive queue reusing its nodes, for hot queues where T can't carry the link itself
+template<typename T>
+using MPSCQueueRecycled = Warhead::Impl::MPSCQueueNonIntrusive<T, true>;
+
 #endif // MPSCQueue_h__
@@ -20,26 +20,36 @@
 
 #include <atomic>
 #include <condition_variable>
+#include <deque>
+#include <iterator>
 #include <mutex>
-#include <queue>
 #include <type_traits>
+#include <utility>
 
 template <typename T>
 class ProducerConsumerQueue
 {
 private:
-    std::mutex _queueLock;
-    std::queue<T> _queue;
+    mutable std::mutex _queueLock;
+    std::deque<T> _queue;
     std::condition_variable _condition;
     std::atomic<bool> _shutdown;
 
 public:
-    ProducerConsumerQueue<T>() : _shutdown(false) { }
+    ProducerConsumerQueue() : _shutdown(false) { }
 
     void Push(const T& value)
     {
         std::lock_guard<std::mutex> lock(_queueLock);
-        _queue.push(std::move(value));
+        _queue.push_back(value);
+
+        _condition.notify_one();
+    }
+
+    void Push(T&& value)
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+        _queue.push_back(std::move(value));
 
         _condition.notify_one();
     }
@@ -53,6 +63,8 @@ public:
 
     [[nodiscard]] size_t Size() const
     {
+        std::lock_guard<std::mutex> lock(_queueLock);
+
         return _queue.size();
     }
 
@@ -65,9 +77,9 @@ public:
             return false;
         }
 
-        value = _queue.front();
+        value = std::move(_queue.front());
 
-        _queue.pop();
+        _queue.pop_front();
 
         return true;
     }
@@ -88,9 +100,46 @@ public:
             return;
         }
 
-        value = _queue.front();
+        value = std::move(_queue.front());
+
+        _queue.pop_front();
+    }
+
+    // Moves all pending elements to the back of values with a single lock acquisition.
+    // An empty values is swapped with the queue storage instead of moving the elements one by one, the queue then
+    // continues with the container values held before
+    bool PopAll(std::deque<T>& values)
+    {
+        std::lock_guard<std::mutex> lock(_queueLock);
+
+        if (_queue.empty() || _shutdown)
+        {
+            return false;
+        }
+
+        MoveAllTo(values);
+
+        return true;
+    }
+
+    // Waits until the queue has elements, then moves all of them to values. Returns false if the queue is cancelled
+    bool WaitAndPopAll(std::deque<T>& values)
+    {
+        std::unique_lock<std::mutex> lock(_queueLock);
+
+        while (_queue.empty() && !_shutdown)
+        {
+            _condition.wait(lock);
+        }
+
+        if (_queue.empty() || _shutdown)
+        {
+            return false;
+        }
+
+        MoveAllTo(values);
 
-        _queue.pop();
+        return true;
     }
 
     void Cancel()
@@ -103,7 +152,7 @@ public:
 
             DeleteQueuedObject(value);
 
-            _queue.pop();
+            _queue.pop_front();
         }
 
         _shutdown = true;
@@ -112,6 +161,18 @@ public:
     }
 
 private:
+    void MoveAllTo(std::deque<T>& values)
+    {
+        if (values.empty())
+        {
+            std::swap(values, _queue);
+            return;
+        }
+
+        values.insert(values.end(), std::make_move_iterator(_queue.begin()), std::make_move_iterator(_queue.end()));
+        _queue.clear();
+    }
+
     template<typename E = T>
     typename std::enable_if<std::is_pointer<E>::value>::type DeleteQueuedObject(E& obj) { delete obj; }
 
@@ -0,0 +1,187 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SPSCQueue_h__
+#define SPSCQueue_h__
+
+#include "Define.h"
+#include "Errors.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace Warhead
+{
+// Bounded wait-free queue for exactly one producer and one consumer thread.
+// Capacity is rounded up to a power of two, slots are constructed in place and nothing is allocated after construction.
+// Each side keeps its own index and a cached copy of the other side's index on its own cache line,
+// the shared indices are only read when the cached copy says the queue looks full (producer) or empty (consumer)
+template<typename T>
+class SPSCQueue
+{
+public:
+    explicit SPSCQueue(std::size_t capacity) : _mask(RoundUpToPowerOfTwo(capacity) - 1), _slots(std::make_unique<Slot[]>(_mask + 1))
+    {
+        ASSERT(capacity > 0);
+    }
+
+    ~SPSCQueue()
+    {
+        std::size_t tail = _consumer.Index.load(std::memory_order_relaxed);
+        std::size_t head = _producer.Index.load(std::memory_order_relaxed);
+
+        for (; tail != head; ++tail)
+            Get(tail)->~T();
+    }
+
+    // Producer side. Returns false if the queue is full
+    template<typename... Args>
+    bool Emplace(Args&&... args)
+    {
+        std::size_t head = _producer.Index.load(std::memory_order_relaxed);
+        if (head - _producer.OtherIndex > _mask)
+        {
+            _producer.OtherIndex = _consumer.Index.load(std::memory_order_acquire);
+            if (head - _producer.OtherIndex > _mask)
+                return false;
+        }
+
+        new (&_slots[head & _mask]) T(std::forward<Args>(args)...);
+        _producer.Index.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Push(T const& value) { return Emplace(value); }
+    bool Push(T&& value) { return Emplace(std::move(value)); }
+
+    // Producer side. Moves up to count elements from first, all of them become visible to the consumer at once.
+    // Returns number of elements pushed
+    template<typename InputIt>
+    std::size_t PushBatch(InputIt first, std::size_t count)
+    {
+        std::size_t head = _producer.Index.load(std::memory_order_relaxed);
+        std::size_t space = _mask + 1 - (head - _producer.OtherIndex);
+        if (space < count)
+        {
+            _producer.OtherIndex = _consumer.Index.load(std::memory_order_acquire);
+            space = _mask + 1 - (head - _producer.OtherIndex);
+        }
+
+        count = std::min(count, space);
+
+        for (std::size_t i = 0; i < count; ++i, ++first)
+            new (&_slots[(head + i) & _mask]) T(std::move(*first));
+
+        if (count)
+            _producer.Index.store(head + count, std::memory_order_release);
+
+        return count;
+    }
+
+    // Consumer side. Returns false if the queue is empty
+    bool Pop(T& value)
+    {
+        std::size_t tail = _consumer.Index.load(std::memory_order_relaxed);
+        if (tail == _consumer.OtherIndex)
+        {
+            _consumer.OtherIndex = _producer.Index.load(std::memory_order_acquire);
+            if (tail == _consumer.OtherIndex)
+                return false;
+        }
+
+        T* slot = Get(tail);
+        value = std::move(*slot);
+        slot->~T();
+
+        _consumer.Index.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer side. Moves up to maxCount elements to out, their slots are handed back to the producer at once.
+    // Returns number of elements popped
+    template<typename OutputIt>
+    std::size_t PopBatch(OutputIt out, std::size_t maxCount)
+    {
+        std::size_t tail = _consumer.Index.load(std::memory_order_relaxed);
+        std::size_t available = _consumer.OtherIndex - tail;
+        if (available < maxCount)
+        {
+            _consumer.OtherIndex = _producer.Index.load(std::memory_order_acquire);
+            available = _consumer.OtherIndex - tail;
+        }
+
+        std::size_t count = std::min(maxCount, available);
+
+        for (std::size_t i = 0; i < count; ++i, ++out)
+        {
+            T* slot = Get(tail + i);
+            *out = std::move(*slot);
+            slot->~T();
+        }
+
+        if (count)
+            _consumer.Index.store(tail + count, std::memory_order_release);
+
+        return count;
+    }
+
+    // Approximate when called while the other side is running
+    std::size_t Size() const
+    {
+        return _producer.Index.load(std::memory_order_acquire) - _consumer.Index.load(std::memory_order_acquire);
+    }
+
+    bool Empty() const { return Size() == 0; }
+    std::size_t Capacity() const { return _mask + 1; }
+
+private:
+    using Slot = std::aligned_storage_t<sizeof(T), alignof(T)>;
+
+    // Index written by one side and the last seen index of the other side, read only by the same side
+    struct alignas(WARHEAD_CACHE_LINE_SIZE) Side
+    {
+        std::atomic<std::size_t> Index{ 0 };
+        std::size_t OtherIndex{ 0 };
+    };
+
+    static std::size_t RoundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value)
+            result <<= 1;
+
+        return result;
+    }
+
+    T* Get(std::size_t index) { return std::launder(reinterpret_cast<T*>(&_slots[index & _mask])); }
+
+    Side _producer;
+    Side _consumer;
+
+    // Read only after construction, kept off the lines written by producer and consumer
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::size_t const _mask;
+    std::unique_ptr<Slot[]> const _slots;
+
+    SPSCQueue(SPSCQueue const&) = delete;
+    SPSCQueue& operator=(SPSCQueue const&) = delete;
+};
+}
+
+#endif // SPSCQueue_h__
@@ -0,0 +1,249 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+#include "AtomicWait.h"
+#include "Log.h"
+#include "StringFormat.h"
+#include "ThreadUtils.h"
+#include <exception>
+
+namespace
+{
+    // Per worker deque size, tasks beyond it go to the shared queue
+    constexpr std::size_t WORKER_QUEUE_SIZE = 4096;
+
+    // Shared queue size per priority, tasks beyond it go to the locked overflow queue
+    constexpr std::size_t INJECTED_QUEUE_SIZE = 16384;
+
+    // Full scans for work before an idle worker goes to sleep
+    constexpr uint32 IDLE_SPIN_COUNT = 64;
+
+    constexpr uint32 SLEEPERS_FLAG = 1;
+
+    thread_local Warhead::ThreadPool const* CurrentPool = nullptr;
+    thread_local void* CurrentWorker = nullptr;
+}
+
+struct Warhead::ThreadPool::Worker
+{
+    explicit Worker(uint32 index) : Index(index)
+    {
+        for (auto& queue : Queues)
+            queue = std::make_unique<WorkStealingQueue<Task>>(WORKER_QUEUE_SIZE);
+    }
+
+    uint32 Index;
+    std::array<std::unique_ptr<WorkStealingQueue<Task>>, std::size_t(TaskPriority::Max)> Queues;
+    uint32 Random{ 0 };
+    std::thread Thread;
+};
+
+Warhead::ThreadPool::ThreadPool(std::string name) : _name(std::move(name))
+{
+    for (auto& queue : _injected)
+        queue = std::make_unique<MPMCQueue<Task*>>(INJECTED_QUEUE_SIZE);
+}
+
+Warhead::ThreadPool::~ThreadPool()
+{
+    Stop();
+
+    for (std::size_t i = 0; i < std::size_t(TaskPriority::Max); ++i)
+    {
+        Task* task = nullptr;
+        while (_injected[i]->TryPop(task))
+            delete task;
+
+        while (_overflow[i].next(task))
+            delete task;
+    }
+}
+
+void Warhead::ThreadPool::Start(uint32 threadCount)
+{
+    ASSERT(_workers.empty() && threadCount > 0);
+
+    _stopping = false;
+
+    for (uint32 i = 0; i < threadCount; ++i)
+        _workers.emplace_back(std::make_unique<Worker>(i));
+
+    // Workers steal from each other, all of them must exist before the first one runs
+    for (auto& worker : _workers)
+        worker->Thread = std::thread(&ThreadPool::Run, this, std::ref(*worker));
+}
+
+void Warhead::ThreadPool::Stop()
+{
+    if (_workers.empty())
+        return;
+
+    _stopping = true;
+
+    _idleEpoch.fetch_add(2, std::memory_order_seq_cst);
+    Thread::AtomicNotifyAll(_idleEpoch);
+
+    for (auto& worker : _workers)
+        worker->Thread.join();
+
+    _workers.clear();
+}
+
+bool Warhead::ThreadPool::IsWorkerThread() const
+{
+    return CurrentPool == this;
+}
+
+void Warhead::ThreadPool::Post(Task task, TaskPriority priority /*= TaskPriority::Normal*/)
+{
+    std::size_t index = std::size_t(priority);
+    Task* node = new Task(std::move(task));
+
+    bool queued = IsWorkerThread() && static_cast<Worker*>(CurrentWorker)->Queues[index]->Push(node);
+
+    if (!queued && !_injected[index]->TryPush(std::move(node)))
+    {
+        _overflow[index].add(node);
+        _overflowCount.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    WakeWorkers();
+}
+
+void Warhead::ThreadPool::WakeWorkers()
+{
+    // Pairs with the fence of a worker going to sleep: either it sees the new task or we see its flag
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+
+    uint32 epoch = _idleEpoch.load(std::memory_order_relaxed);
+    if (!(epoch & SLEEPERS_FLAG))
+        return;
+
+    if (_idleEpoch.compare_exchange_strong(epoch, (epoch + 2) & ~SLEEPERS_FLAG, std::memory_order_release, std::memory_order_relaxed))
+        Thread::AtomicNotifyAll(_idleEpoch);
+}
+
+void Warhead::ThreadPool::Run(Worker& worker)
+{
+    Thread::SetCurrentThreadName(Warhead::StringFormat("{} {}", _name, worker.Index));
+
+    CurrentPool = this;
+    CurrentWorker = &worker;
+    worker.Random = worker.Index * 2654435761u + 1;
+
+    for (;;)
+    {
+        Task* task = nullptr;
+
+        for (uint32 i = 0; i < IDLE_SPIN_COUNT && !task; ++i)
+        {
+            task = FindTask(worker);
+            if (!task)
+                Thread::CpuRelax();
+        }
+
+        if (task)
+        {
+            Execute(task);
+            continue;
+        }
+
+        uint32 epoch = _idleEpoch.fetch_or(SLEEPERS_FLAG, std::memory_order_seq_cst) | SLEEPERS_FLAG;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if (Task* lastChance = FindTask(worker))
+        {
+            Execute(lastChance);
+            continue;
+        }
+
+        // Queued tasks are done at this point, Stop waits for them
+        if (_stopping.load(std::memory_order_acquire))
+            break;
+
+        Thread::AtomicWait(_idleEpoch, epoch);
+    }
+
+    CurrentPool = nullptr;
+    CurrentWorker = nullptr;
+}
+
+Warhead::ThreadPool::Task* Warhead::ThreadPool::FindTask(Worker& worker)
+{
+    for (std::size_t priority = 0; priority < std::size_t(TaskPriority::Max); ++priority)
+    {
+        if (Task* task = worker.Queues[priority]->Pop())
+            return task;
+
+        Task* task = nullptr;
+        if (_injected[priority]->TryPop(task))
+            return task;
+
+        if (_overflowCount.load(std::memory_order_relaxed) && _overflow[priority].next(task))
+        {
+            _overflowCount.fetch_sub(1, std::memory_order_relaxed);
+            return task;
+        }
+
+        if (Task* stolen = StealTask(worker, priority))
+            return stolen;
+    }
+
+    return nullptr;
+}
+
+Warhead::ThreadPool::Task* Warhead::ThreadPool::StealTask(Worker& worker, std::size_t priority)
+{
+    std::size_t count = _workers.size();
+    if (count < 2)
+        return nullptr;
+
+    // Start at a random victim so idle workers don't all hit the same deque
+    worker.Random = worker.Random * 1664525u + 1013904223u;
+    std::size_t start = worker.Random % count;
+
+    for (std::size_t i = 0; i < count; ++i)
+    {
+        Worker& victim = *_workers[(start + i) % count];
+        if (&victim == &worker)
+            continue;
+
+        if (Task* task = victim.Queues[priority]->Steal())
+            return task;
+    }
+
+    return nullptr;
+}
+
+void Warhead::ThreadPool::Execute(Task* task)
+{
+    try
+    {
+        (*task)();
+    }
+    catch (std::exception const& e)
+    {
+        LOG_ERROR("server", "> Thread pool '{}' task failed: {}", _name, e.what());
+    }
+    catch (...)
+    {
+        LOG_ERROR("server", "> Thread pool '{}' task failed with an unknown exception", _name);
+    }
+
+    delete task;
+}
@@ -0,0 +1,96 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREAD_POOL_H_
+#define _THREAD_POOL_H_
+
+#include "Define.h"
+#include "LockedQueue.h"
+#include "MPMCQueue.h"
+#include "WorkStealingQueue.h"
+#include <array>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace Warhead
+{
+    enum class TaskPriority : uint8
+    {
+        High,
+        Normal,
+        Low,
+
+        Max
+    };
+
+    // Work stealing pool for background work (persistence, reports, formatting) that must stay off the network threads.
+    // Workers keep their own Chase-Lev deque per priority, tasks posted by a worker go to its own deque and idle
+    // workers steal from the others. Other threads post to a bounded lock free queue, when it is full the task goes to
+    // a mutex protected overflow queue. Higher priority tasks are taken first, there is no preemption of running tasks
+    class WH_COMMON_API ThreadPool
+    {
+    public:
+        using Task = std::function<void()>;
+
+        explicit ThreadPool(std::string name);
+        ~ThreadPool();
+
+        ThreadPool(ThreadPool const&) = delete;
+        ThreadPool& operator=(ThreadPool const&) = delete;
+
+        void Start(uint32 threadCount);
+
+        // Runs all tasks posted so far and joins the workers, tasks posted afterwards are dropped
+        void Stop();
+
+        // Thread safe. Lock free unless the shared queue of the priority is full, then it takes the overflow queue mutex.
+        // Exceptions escaping a task are logged and swallowed, the worker moves on to the next task
+        void Post(Task task, TaskPriority priority = TaskPriority::Normal);
+
+        uint32 GetThreadCount() const { return uint32(_workers.size()); }
+
+        // True if called from a worker of this pool
+        bool IsWorkerThread() const;
+
+    private:
+        struct Worker;
+
+        void Run(Worker& worker);
+        Task* FindTask(Worker& worker);
+        Task* StealTask(Worker& worker, std::size_t priority);
+        void Execute(Task* task);
+        void WakeWorkers();
+
+        std::string _name;
+        std::vector<std::unique_ptr<Worker>> _workers;
+
+        // Tasks posted from outside the pool, the locked queue only takes what does not fit
+        std::array<std::unique_ptr<MPMCQueue<Task*>>, std::size_t(TaskPriority::Max)> _injected;
+        std::array<LockedQueue<Task*>, std::size_t(TaskPriority::Max)> _overflow;
+        std::atomic<uint32> _overflowCount{ 0 };
+
+        // Event count of idle workers, lowest bit set while a worker is going to sleep
+        alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<uint32> _idleEpoch{ 0 };
+        std::atomic<bool> _stopping{ false };
+    };
+}
+
+#endif // _THREAD_POOL_H_
@@ -0,0 +1,161 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadUtils.h"
+#include "Log.h"
+#include "StringConvert.h"
+#include "Tokenize.h"
+#include <cerrno>
+#include <climits>
+#include <fstream>
+#include <string>
+
+// WARHEAD_PLATFORM_UNIX also covers the BSDs, cpu sets, set_mempolicy and pthread_setname_np(thread, name) are Linux only
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+#include <windows.h>
+#elif WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+#include <linux/mempolicy.h>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#elif WARHEAD_PLATFORM == WARHEAD_PLATFORM_APPLE
+#include <pthread.h>
+#endif
+
+namespace
+{
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    // Parse cpu list like "0-15,32-47" from /sys/devices/system/node/nodeN/cpulist
+    bool GetNumaNodeCpus(uint32 node, cpu_set_t& cpus)
+    {
+        std::ifstream in("/sys/devices/system/node/node" + std::to_string(node) + "/cpulist");
+        if (in.fail())
+            return false;
+
+        std::string cpuList;
+        std::getline(in, cpuList);
+
+        CPU_ZERO(&cpus);
+
+        for (auto const& range : Warhead::Tokenize(cpuList, ',', false))
+        {
+            auto const& bounds = Warhead::Tokenize(range, '-', false);
+            if (bounds.empty() || bounds.size() > 2)
+                return false;
+
+            auto first = Warhead::StringTo<uint32>(bounds.front());
+            auto last = Warhead::StringTo<uint32>(bounds.back());
+            if (!first || !last || *first > *last)
+                return false;
+
+            for (uint32 cpu = *first; cpu <= *last && cpu < CPU_SETSIZE; ++cpu)
+                CPU_SET(cpu, &cpus);
+        }
+
+        return CPU_COUNT(&cpus) > 0;
+    }
+#endif
+}
+
+void Warhead::Thread::SetCurrentThreadName(std::string_view name)
+{
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    // 15 characters + null terminator
+    std::string threadName(name.substr(0, 15));
+    pthread_setname_np(pthread_self(), threadName.c_str());
+#elif WARHEAD_PLATFORM == WARHEAD_PLATFORM_APPLE
+    pthread_setname_np(std::string(name).c_str());
+#else
+    (void)name;
+#endif
+}
+
+bool Warhead::Thread::SetCurrentThreadAffinity(uint32 cpu)
+{
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    if (cpu >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+
+    if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+    {
+        LOG_ERROR("server", "> Failed to pin thread to cpu {}. Error {}", cpu, error);
+        return false;
+    }
+
+    return true;
+#elif WARHEAD_PLATFORM == WARHEAD_PLATFORM_WINDOWS
+    if (cpu >= 64)
+        return false;
+
+    if (!SetThreadAffinityMask(GetCurrentThread(), DWORD_PTR(1) << cpu))
+    {
+        LOG_ERROR("server", "> Failed to pin thread to cpu {}. Error {}", cpu, GetLastError());
+        return false;
+    }
+
+    return true;
+#else
+    LOG_ERROR("server", "> Thread affinity is not supported on this platform. Cpu {} ignored", cpu);
+    return false;
+#endif
+}
+
+bool Warhead::Thread::SetCurrentThreadNumaNode(uint32 node, bool keepAffinity /*= false*/)
+{
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    if (!keepAffinity)
+    {
+        cpu_set_t cpus;
+        if (!GetNumaNodeCpus(node, cpus))
+        {
+            LOG_ERROR("server", "> Failed to read cpu list of NUMA node {}", node);
+            return false;
+        }
+
+        if (int error = pthread_setaffinity_np(pthread_self(), sizeof(cpus), &cpus))
+        {
+            LOG_ERROR("server", "> Failed to bind thread to cpus of NUMA node {}. Error {}", node, error);
+            return false;
+        }
+    }
+
+    // Prefer node-local allocations, fall back to other nodes if the node runs out of memory
+    constexpr std::size_t maskBits = sizeof(unsigned long) * CHAR_BIT * 16;
+    if (node >= maskBits)
+        return false;
+
+    unsigned long nodeMask[16] = {};
+    nodeMask[node / (sizeof(unsigned long) * CHAR_BIT)] |= 1ul << (node % (sizeof(unsigned long) * CHAR_BIT));
+
+    if (syscall(SYS_set_mempolicy, MPOL_PREFERRED, nodeMask, maskBits + 1) != 0)
+    {
+        LOG_ERROR("server", "> Failed to set memory policy for NUMA node {}. Error {}", node, errno);
+        return false;
+    }
+
+    return true;
+#else
+    (void)keepAffinity;
+    LOG_ERROR("server", "> NUMA placement is not supported on this platform. Node {} ignored", node);
+    return false;
+#endif
+}
@@ -0,0 +1,38 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _THREAD_UTILS_H_
+#define _THREAD_UTILS_H_
+
+#include "Define.h"
+#include <string_view>
+
+namespace Warhead::Thread
+{
+    // Sets the name of the calling thread, visible in top -H, perf and gdb.
+    // Linux limits names to 15 characters, longer names are truncated
+    WH_COMMON_API void SetCurrentThreadName(std::string_view name);
+
+    // Pins the calling thread to a single logical cpu
+    WH_COMMON_API bool SetCurrentThreadAffinity(uint32 cpu);
+
+    // Restricts the calling thread to the cpus of a NUMA node and makes it prefer node-local memory.
+    // Only the memory policy is changed if keepAffinity is set (thread is already pinned inside the node)
+    WH_COMMON_API bool SetCurrentThreadNumaNode(uint32 node, bool keepAffinity = false);
+}
+
+#endif // _THREAD_UTILS_H_
@@ -0,0 +1,125 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef WorkStealingQueue_h__
+#define WorkStealingQueue_h__
+
+#include "Define.h"
+#include "Errors.h"
+#include <atomic>
+#include <memory>
+
+namespace Warhead
+{
+// Chase-Lev work stealing deque of pointers with fixed capacity, memory orders from
+// "Correct and Efficient Work-Stealing for Weak Memory Models" (Le, Pop, Cohen, Zappa Nardelli, 2013).
+// The owner thread pushes and pops at the bottom (LIFO, cache warm), any other thread steals from the top (FIFO).
+// Push fails when the deque is full, callers fall back to a shared queue instead of growing the array
+template<typename T>
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(std::size_t capacity) : _mask(RoundUpToPowerOfTwo(capacity) - 1), _items(std::make_unique<std::atomic<T*>[]>(_mask + 1))
+    {
+        ASSERT(capacity > 0);
+    }
+
+    // Owner thread only
+    bool Push(T* item)
+    {
+        int64 bottom = _bottom.load(std::memory_order_relaxed);
+        int64 top = _top.load(std::memory_order_acquire);
+        if (bottom - top > int64(_mask))
+            return false;
+
+        // Release store instead of the paper's release fence, same code on x86 and visible to thread sanitizer
+        _items[bottom & _mask].store(item, std::memory_order_relaxed);
+        _bottom.store(bottom + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Owner thread only
+    T* Pop()
+    {
+        int64 bottom = _bottom.load(std::memory_order_relaxed) - 1;
+        _bottom.store(bottom, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 top = _top.load(std::memory_order_relaxed);
+
+        if (top > bottom)
+        {
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        T* item = _items[bottom & _mask].load(std::memory_order_relaxed);
+        if (top == bottom)
+        {
+            // Last item, race against thieves
+            if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+                item = nullptr;
+
+            _bottom.store(bottom + 1, std::memory_order_relaxed);
+        }
+
+        return item;
+    }
+
+    // Any thread. Returns nullptr if the deque is empty or another thread won the race for the top item
+    T* Steal()
+    {
+        int64 top = _top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64 bottom = _bottom.load(std::memory_order_acquire);
+
+        if (top >= bottom)
+            return nullptr;
+
+        T* item = _items[top & _mask].load(std::memory_order_relaxed);
+        if (!_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+            return nullptr;
+
+        return item;
+    }
+
+    // Approximate unless called by the owner while nobody steals
+    bool Empty() const
+    {
+        return _top.load(std::memory_order_relaxed) >= _bottom.load(std::memory_order_relaxed);
+    }
+
+private:
+    static std::size_t RoundUpToPowerOfTwo(std::size_t value)
+    {
+        std::size_t result = 1;
+        while (result < value)
+            result <<= 1;
+
+        return result;
+    }
+
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<int64> _top{ 0 };
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::atomic<int64> _bottom{ 0 };
+    alignas(WARHEAD_CACHE_LINE_SIZE) std::size_t const _mask;
+    std::unique_ptr<std::atomic<T*>[]> const _items;
+
+    WorkStealingQueue(WorkStealingQueue const&) = delete;
+    WorkStealingQueue& operator=(WorkStealingQueue const&) = delete;
+};
+}
+
+#endif // WorkStealingQueue_h__
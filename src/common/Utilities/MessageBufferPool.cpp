@@ -0,0 +1,309 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MessageBufferPool.h"
+#include <algorithm>
+#include <atomic>
+
+namespace
+{
+    // Free chunks kept by every thread per chunk size, fewer of the bigger ones
+    constexpr std::size_t LOCAL_CACHE_SIZE[static_cast<std::size_t>(MessageBufferChunk::Max)] = { 32, 16, 4 };
+
+    // Chunks moved between thread cache and depot at once
+    constexpr std::size_t GetTransferBatchSize(MessageBufferChunk chunk)
+    {
+        return LOCAL_CACHE_SIZE[static_cast<std::size_t>(chunk)] / 2;
+    }
+
+    // Counters are written only by the owning thread, no need for atomic increment
+    inline void Increment(std::atomic<uint64>& counter)
+    {
+        counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+    }
+
+    constexpr std::size_t ToIndex(MessageBufferChunk chunk)
+    {
+        return static_cast<std::size_t>(chunk);
+    }
+
+    MessageBufferChunk GetChunkForSize(std::size_t size)
+    {
+        for (std::size_t i = 0; i < ToIndex(MessageBufferChunk::Max); ++i)
+            if (size <= MESSAGE_BUFFER_CHUNK_SIZE[i])
+                return MessageBufferChunk(i);
+
+        return MessageBufferChunk::Max;
+    }
+
+    MessageBufferChunk GetChunkForStorage(std::vector<uint8> const& storage)
+    {
+        for (std::size_t i = 0; i < ToIndex(MessageBufferChunk::Max); ++i)
+            if (storage.size() == MESSAGE_BUFFER_CHUNK_SIZE[i])
+                return MessageBufferChunk(i);
+
+        return MessageBufferChunk::Max;
+    }
+}
+
+struct MessageBufferPool::LocalCache
+{
+    LocalCache()
+    {
+        sMessageBufferPool->RegisterCache(this);
+    }
+
+    ~LocalCache()
+    {
+        LocalCacheDestroyed() = true;
+
+        for (std::size_t i = 0; i < ToIndex(MessageBufferChunk::Max); ++i)
+            Drops += sMessageBufferPool->Flush(MessageBufferChunk(i), Chunks[i], 0);
+
+        sMessageBufferPool->UnregisterCache(this);
+    }
+
+    std::array<ChunkList, ToIndex(MessageBufferChunk::Max)> Chunks;
+
+    std::atomic<uint64> LocalHits{ 0 };
+    std::atomic<uint64> SharedHits{ 0 };
+    std::atomic<uint64> Misses{ 0 };
+    std::atomic<uint64> Returns{ 0 };
+    std::atomic<uint64> Drops{ 0 };
+};
+
+MessageBufferPool* MessageBufferPool::instance()
+{
+    static MessageBufferPool instance;
+    return &instance;
+}
+
+MessageBufferPool::LocalCache& MessageBufferPool::GetLocalCache()
+{
+    thread_local LocalCache cache;
+    return cache;
+}
+
+bool& MessageBufferPool::LocalCacheDestroyed()
+{
+    thread_local bool destroyed = false;
+    return destroyed;
+}
+
+void MessageBufferPool::RegisterCache(LocalCache* cache)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+    _caches.push_back(cache);
+}
+
+void MessageBufferPool::UnregisterCache(LocalCache* cache)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _retiredStats.LocalHits += cache->LocalHits.load(std::memory_order_relaxed);
+    _retiredStats.SharedHits += cache->SharedHits.load(std::memory_order_relaxed);
+    _retiredStats.Misses += cache->Misses.load(std::memory_order_relaxed);
+    _retiredStats.Returns += cache->Returns.load(std::memory_order_relaxed);
+    _retiredStats.Drops += cache->Drops.load(std::memory_order_relaxed);
+
+    _caches.erase(std::remove(_caches.begin(), _caches.end(), cache), _caches.end());
+}
+
+void MessageBufferPool::Reserve(std::size_t count)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    _depotLimit[ToIndex(MessageBufferChunk::Small)] = count;
+    _depotLimit[ToIndex(MessageBufferChunk::Large)] = count / 16;
+    _depotLimit[ToIndex(MessageBufferChunk::Huge)] = count / 64;
+
+    ChunkList& depot = _depot[ToIndex(MessageBufferChunk::Small)];
+    depot.reserve(count);
+
+    while (depot.size() < count)
+        depot.emplace_back(MESSAGE_BUFFER_CHUNK_SIZE[ToIndex(MessageBufferChunk::Small)]);
+}
+
+std::vector<uint8> MessageBufferPool::Acquire(std::size_t size)
+{
+    MessageBufferChunk chunk = GetChunkForSize(size);
+
+    // Buffers used by thread_local destructors after the cache went away come from the depot directly
+    if (LocalCacheDestroyed())
+        return AcquireFromDepot(chunk, size);
+
+    LocalCache& cache = GetLocalCache();
+
+    if (chunk == MessageBufferChunk::Max)
+    {
+        Increment(cache.Misses);
+        return std::vector<uint8>(size);
+    }
+
+    ChunkList& local = cache.Chunks[ToIndex(chunk)];
+    if (!local.empty())
+        Increment(cache.LocalHits);
+    else
+    {
+        Refill(chunk, local);
+
+        if (local.empty())
+        {
+            Increment(cache.Misses);
+            return std::vector<uint8>(MESSAGE_BUFFER_CHUNK_SIZE[ToIndex(chunk)]);
+        }
+
+        Increment(cache.SharedHits);
+    }
+
+    std::vector<uint8> storage = std::move(local.back());
+    local.pop_back();
+    return storage;
+}
+
+void MessageBufferPool::Release(std::vector<uint8> storage)
+{
+    // Already released or moved out
+    if (storage.empty())
+        return;
+
+    MessageBufferChunk chunk = GetChunkForStorage(storage);
+
+    if (LocalCacheDestroyed())
+    {
+        ReleaseToDepot(chunk, std::move(storage));
+        return;
+    }
+
+    LocalCache& cache = GetLocalCache();
+
+    if (chunk == MessageBufferChunk::Max)
+    {
+        Increment(cache.Drops);
+        return;
+    }
+
+    ChunkList& local = cache.Chunks[ToIndex(chunk)];
+    local.emplace_back(std::move(storage));
+    Increment(cache.Returns);
+
+    if (local.size() > LOCAL_CACHE_SIZE[ToIndex(chunk)])
+    {
+        std::size_t dropped = Flush(chunk, local, LOCAL_CACHE_SIZE[ToIndex(chunk)] - GetTransferBatchSize(chunk));
+        cache.Drops.store(cache.Drops.load(std::memory_order_relaxed) + dropped, std::memory_order_relaxed);
+    }
+}
+
+std::vector<uint8> MessageBufferPool::AcquireFromDepot(MessageBufferChunk chunk, std::size_t size)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (chunk == MessageBufferChunk::Max)
+    {
+        ++_retiredStats.Misses;
+        return std::vector<uint8>(size);
+    }
+
+    ChunkList& depot = _depot[ToIndex(chunk)];
+    if (depot.empty())
+    {
+        ++_retiredStats.Misses;
+        return std::vector<uint8>(MESSAGE_BUFFER_CHUNK_SIZE[ToIndex(chunk)]);
+    }
+
+    ++_retiredStats.SharedHits;
+
+    std::vector<uint8> storage = std::move(depot.back());
+    depot.pop_back();
+    return storage;
+}
+
+void MessageBufferPool::ReleaseToDepot(MessageBufferChunk chunk, std::vector<uint8>&& storage)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    if (chunk == MessageBufferChunk::Max || _depot[ToIndex(chunk)].size() >= _depotLimit[ToIndex(chunk)])
+    {
+        ++_retiredStats.Drops;
+        return;
+    }
+
+    _depot[ToIndex(chunk)].emplace_back(std::move(storage));
+    ++_retiredStats.Returns;
+}
+
+void MessageBufferPool::Refill(MessageBufferChunk chunk, ChunkList& local)
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    ChunkList& depot = _depot[ToIndex(chunk)];
+
+    for (std::size_t i = 0; i < GetTransferBatchSize(chunk) && !depot.empty(); ++i)
+    {
+        local.emplace_back(std::move(depot.back()));
+        depot.pop_back();
+    }
+}
+
+std::size_t MessageBufferPool::Flush(MessageBufferChunk chunk, ChunkList& local, std::size_t keep)
+{
+    std::size_t dropped = 0;
+
+    if (local.size() <= keep)
+        return dropped;
+
+    std::lock_guard<std::mutex> lock(_lock);
+
+    ChunkList& depot = _depot[ToIndex(chunk)];
+    std::size_t limit = _depotLimit[ToIndex(chunk)];
+
+    while (local.size() > keep)
+    {
+        if (depot.size() < limit)
+            depot.emplace_back(std::move(local.back()));
+        else
+            ++dropped;
+
+        local.pop_back();
+    }
+
+    return dropped;
+}
+
+std::size_t MessageBufferPool::GetStorageSize(std::size_t size)
+{
+    MessageBufferChunk chunk = GetChunkForSize(size);
+    return chunk != MessageBufferChunk::Max ? MESSAGE_BUFFER_CHUNK_SIZE[ToIndex(chunk)] : size;
+}
+
+MessageBufferPoolStats MessageBufferPool::GetStats()
+{
+    std::lock_guard<std::mutex> lock(_lock);
+
+    MessageBufferPoolStats stats = _retiredStats;
+
+    for (LocalCache const* cache : _caches)
+    {
+        stats.LocalHits += cache->LocalHits.load(std::memory_order_relaxed);
+        stats.SharedHits += cache->SharedHits.load(std::memory_order_relaxed);
+        stats.Misses += cache->Misses.load(std::memory_order_relaxed);
+        stats.Returns += cache->Returns.load(std::memory_order_relaxed);
+        stats.Drops += cache->Drops.load(std::memory_order_relaxed);
+    }
+
+    return stats;
+}
@@ -0,0 +1,105 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MESSAGE_BUFFER_POOL_H_
+#define _MESSAGE_BUFFER_POOL_H_
+
+#include "Define.h"
+#include <array>
+#include <mutex>
+#include <vector>
+
+enum class MessageBufferChunk : uint8
+{
+    Small,  // 4 KB
+    Large,  // 64 KB
+    Huge,   // 256 KB, default Network.ReadBuffer.MaxSize
+
+    Max
+};
+
+constexpr std::size_t MESSAGE_BUFFER_CHUNK_SIZE[static_cast<std::size_t>(MessageBufferChunk::Max)] = { 4 * 1024, 64 * 1024, 256 * 1024 };
+
+struct MessageBufferPoolStats
+{
+    uint64 LocalHits{ 0 };  // Chunk taken from the calling thread cache
+    uint64 SharedHits{ 0 }; // Thread cache refilled from the shared depot
+    uint64 Misses{ 0 };     // New allocation, pool was empty or size not pooled
+    uint64 Returns{ 0 };    // Chunk given back to the pool
+    uint64 Drops{ 0 };      // Returned storage freed, pool full or size not pooled
+};
+
+// Pool of fixed size chunks used as MessageBuffer storage (socket read buffers).
+// Every thread keeps a small cache of free chunks, the shared depot is only locked
+// to move chunks between threads in batches
+class WH_COMMON_API MessageBufferPool
+{
+    MessageBufferPool() = default;
+    ~MessageBufferPool() = default;
+    MessageBufferPool(MessageBufferPool const&) = delete;
+    MessageBufferPool(MessageBufferPool&&) = delete;
+    MessageBufferPool& operator=(MessageBufferPool const&) = delete;
+    MessageBufferPool& operator=(MessageBufferPool&&) = delete;
+
+public:
+    static MessageBufferPool* instance();
+
+    // Pre-allocate count small chunks. Depot keeps at most count free small, count / 16 free large and count / 64 free huge chunks
+    void Reserve(std::size_t count);
+
+    // Storage of at least size bytes, rounded up to the chunk size. Sizes above the largest chunk are not pooled
+    std::vector<uint8> Acquire(std::size_t size);
+
+    // Return storage to the pool. Storage of other sizes than chunk sizes is freed
+    void Release(std::vector<uint8> storage);
+
+    MessageBufferPoolStats GetStats();
+
+    // Size of the storage Acquire(size) returns
+    static std::size_t GetStorageSize(std::size_t size);
+
+private:
+    struct LocalCache;
+
+    using ChunkList = std::vector<std::vector<uint8>>;
+
+    LocalCache& GetLocalCache();
+
+    // Set when the cache of the calling thread was destroyed. Trivially destructible, still readable while
+    // other thread_local objects are destroyed
+    static bool& LocalCacheDestroyed();
+    void RegisterCache(LocalCache* cache);
+    void UnregisterCache(LocalCache* cache);
+
+    // Used by threads whose cache is gone, counted as stats of exited threads
+    std::vector<uint8> AcquireFromDepot(MessageBufferChunk chunk, std::size_t size);
+    void ReleaseToDepot(MessageBufferChunk chunk, std::vector<uint8>&& storage);
+
+    void Refill(MessageBufferChunk chunk, ChunkList& local);
+    // Move chunks above keep to the depot, returns number of chunks freed because depot is full
+    std::size_t Flush(MessageBufferChunk chunk, ChunkList& local, std::size_t keep);
+
+    std::mutex _lock;
+    std::array<ChunkList, static_cast<std::size_t>(MessageBufferChunk::Max)> _depot;
+    std::array<std::size_t, static_cast<std::size_t>(MessageBufferChunk::Max)> _depotLimit{};
+    std::vector<LocalCache*> _caches;
+    MessageBufferPoolStats _retiredStats; // Counters of exited threads
+};
+
+#define sMessageBufferPool MessageBufferPool::instance()
+
+#endif // _MESSAGE_BUFFER_POOL_H_
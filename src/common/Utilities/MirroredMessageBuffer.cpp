@@ -0,0 +1,141 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MirroredMessageBuffer.h"
+#include "Log.h"
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    std::size_t GetPageSize()
+    {
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+        static std::size_t const pageSize = sysconf(_SC_PAGESIZE);
+        return pageSize;
+#else
+        return 4096;
+#endif
+    }
+
+    std::size_t RoundToPageSize(std::size_t size)
+    {
+        std::size_t pageSize = GetPageSize();
+        return std::max<std::size_t>((size + pageSize - 1) / pageSize * pageSize, pageSize);
+    }
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    // Map one memfd twice into a reserved range of 2 * size bytes
+    uint8* MapMirrored(std::size_t size)
+    {
+        int fd = memfd_create("MessageBuffer", MFD_CLOEXEC);
+        if (fd < 0)
+            return nullptr;
+
+        if (ftruncate(fd, size) != 0)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        void* reserved = mmap(nullptr, size * 2, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (reserved == MAP_FAILED)
+        {
+            close(fd);
+            return nullptr;
+        }
+
+        uint8* base = static_cast<uint8*>(reserved);
+
+        bool mapped = mmap(base, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED &&
+            mmap(base + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) != MAP_FAILED;
+
+        // Mappings keep the memory alive
+        close(fd);
+
+        if (!mapped)
+        {
+            munmap(base, size * 2);
+            return nullptr;
+        }
+
+        return base;
+    }
+#endif
+}
+
+void MirroredMessageBuffer::Allocate(std::size_t size)
+{
+    Free();
+
+    size = RoundToPageSize(size);
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    _base = MapMirrored(size);
+    _mirrored = _base != nullptr;
+
+    if (!_mirrored)
+    {
+        static std::atomic<bool> warned{ false };
+        if (!warned.exchange(true))
+            LOG_WARN("network", "MirroredMessageBuffer: Failed to create mirrored mapping ({}), using plain buffers", errno);
+    }
+#endif
+
+    if (!_base)
+        _base = new uint8[size];
+
+    _size = size;
+}
+
+void MirroredMessageBuffer::Resize(std::size_t size)
+{
+    size = RoundToPageSize(size);
+    if (size == _size || GetActiveSize() > size)
+        return;
+
+    MirroredMessageBuffer buffer(size);
+    buffer.Write(GetReadPointer(), GetActiveSize());
+    *this = std::move(buffer);
+}
+
+void MirroredMessageBuffer::Free()
+{
+    if (!_base)
+        return;
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(__linux__)
+    if (_mirrored)
+        munmap(_base, _size * 2);
+    else
+        delete[] _base;
+#else
+    delete[] _base;
+#endif
+
+    _base = nullptr;
+    _size = 0;
+    _rpos = 0;
+    _wpos = 0;
+    _mirrored = false;
+}
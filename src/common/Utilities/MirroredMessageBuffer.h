@@ -0,0 +1,136 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _MIRRORED_MESSAGE_BUFFER_H_
+#define _MIRRORED_MESSAGE_BUFFER_H_
+
+#include "Define.h"
+#include <cstring>
+#include <utility>
+
+// Ring buffer variant of MessageBuffer. The same memory is mapped twice back to back,
+// so unread data and free space are always contiguous even when they wrap around the end
+// and Normalize() never has to move data. Falls back to plain memory with MessageBuffer
+// behaviour where mirrored mappings are not available (non Linux platforms, no memfd).
+// Every mirrored buffer costs 2 VMAs, keep vm.max_map_count (65530 by default) above twice the session count
+class WH_COMMON_API MirroredMessageBuffer
+{
+public:
+    MirroredMessageBuffer() = default;
+    explicit MirroredMessageBuffer(std::size_t initialSize) { Allocate(initialSize); }
+    ~MirroredMessageBuffer() { Free(); }
+
+    MirroredMessageBuffer(MirroredMessageBuffer const&) = delete;
+    MirroredMessageBuffer& operator=(MirroredMessageBuffer const&) = delete;
+
+    MirroredMessageBuffer(MirroredMessageBuffer&& right) noexcept { Swap(right); }
+
+    MirroredMessageBuffer& operator=(MirroredMessageBuffer&& right) noexcept
+    {
+        if (this != &right)
+        {
+            Free();
+            Swap(right);
+        }
+
+        return *this;
+    }
+
+    // Size is rounded up to the page size. Existing data is discarded
+    void Allocate(std::size_t size);
+
+    // Reallocate with size rounded up to the page size, unread data is kept. Does nothing if unread data does not fit
+    void Resize(std::size_t size);
+
+    [[nodiscard]] bool IsMirrored() const { return _mirrored; }
+
+    void Reset()
+    {
+        _wpos = 0;
+        _rpos = 0;
+    }
+
+    uint8* GetReadPointer() { return _base + _rpos; }
+    uint8* GetWritePointer() { return _base + _wpos; }
+
+    void ReadCompleted(std::size_t bytes)
+    {
+        _rpos += bytes;
+
+        // Keep read position in the first mapping, write position follows it
+        if (_mirrored && _rpos >= _size)
+        {
+            _rpos -= _size;
+            _wpos -= _size;
+        }
+    }
+
+    void WriteCompleted(std::size_t bytes) { _wpos += bytes; }
+
+    [[nodiscard]] std::size_t GetActiveSize() const { return _wpos - _rpos; }
+    [[nodiscard]] std::size_t GetRemainingSpace() const { return _mirrored ? _size - GetActiveSize() : _size - _wpos; }
+    [[nodiscard]] std::size_t GetBufferSize() const { return _size; }
+
+    // Only moves data in fallback mode, mirrored buffers are never normalized
+    void Normalize()
+    {
+        if (!GetActiveSize())
+            Reset();
+        else if (!_mirrored && _rpos)
+        {
+            memmove(_base, GetReadPointer(), GetActiveSize());
+            _wpos -= _rpos;
+            _rpos = 0;
+        }
+    }
+
+    // Ensures there's "some" free space, doubles the buffer if it's full
+    void EnsureFreeSpace()
+    {
+        if (GetRemainingSpace() == 0)
+            Resize(_size * 2);
+    }
+
+    void Write(void const* data, std::size_t size)
+    {
+        if (size)
+        {
+            memcpy(GetWritePointer(), data, size);
+            WriteCompleted(size);
+        }
+    }
+
+private:
+    void Free();
+
+    void Swap(MirroredMessageBuffer& right) noexcept
+    {
+        std::swap(_base, right._base);
+        std::swap(_size, right._size);
+        std::swap(_rpos, right._rpos);
+        std::swap(_wpos, right._wpos);
+        std::swap(_mirrored, right._mirrored);
+    }
+
+    uint8* _base{ nullptr };
+    std::size_t _size{ 0 };
+    std::size_t _rpos{ 0 };
+    std::size_t _wpos{ 0 };
+    bool _mirrored{ false };
+};
+
+#endif // _MIRRORED_MESSAGE_BUFFER_H_
@@ -0,0 +1,239 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _POOL_ALLOCATOR_H_
+#define _POOL_ALLOCATOR_H_
+
+#include "Define.h"
+#include <algorithm>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace Warhead
+{
+    namespace Impl
+    {
+        // Number of blocks allocated at once when a pool of the Tag family runs out of free blocks
+        template<typename Tag>
+        inline std::atomic<std::size_t> PoolSlabSize{ 64 };
+
+        // Free blocks kept by every thread per block size
+        constexpr std::size_t POOL_LOCAL_CACHE_SIZE = 64;
+
+        // Blocks moved between thread cache and depot at once
+        constexpr std::size_t POOL_TRANSFER_BATCH_SIZE = POOL_LOCAL_CACHE_SIZE / 2;
+
+        // Free list of fixed size blocks. Every thread keeps a small cache of free blocks, the shared
+        // depot is only locked to move blocks between threads in batches (same scheme as MessageBufferPool).
+        // Blocks are allocated in slabs and never returned to the system, the pool stays at the high-water
+        // mark of live objects, which for sessions is the connection peak the server is sized for anyway.
+        // Every Tag has pools of its own, slab size and memory of one user don't affect the others
+        template<std::size_t BlockSize, std::size_t Alignment, typename Tag>
+        class FixedBlockPool
+        {
+            union Block
+            {
+                Block* Next;
+                alignas(Alignment) uint8 Data[BlockSize];
+            };
+
+            struct BlockList
+            {
+                Block* Head{ nullptr };
+                std::size_t Count{ 0 };
+
+                void Push(Block* block)
+                {
+                    block->Next = Head;
+                    Head = block;
+                    ++Count;
+                }
+
+                Block* Pop()
+                {
+                    Block* block = Head;
+                    Head = block->Next;
+                    --Count;
+                    return block;
+                }
+            };
+
+            struct LocalCache : BlockList
+            {
+                ~LocalCache()
+                {
+                    Instance().Flush(*this, 0);
+                    LocalCacheDestroyed() = true;
+                }
+            };
+
+        public:
+            static FixedBlockPool& Instance()
+            {
+                static FixedBlockPool instance;
+                return instance;
+            }
+
+            void* Allocate()
+            {
+                // Objects destroyed by thread_local destructors after the cache went away use the depot directly
+                if (LocalCacheDestroyed())
+                {
+                    std::lock_guard<std::mutex> lock(_lock);
+
+                    if (!_depot.Head)
+                        AllocateSlab();
+
+                    return _depot.Pop();
+                }
+
+                LocalCache& cache = GetLocalCache();
+                if (!cache.Head)
+                    Refill(cache);
+
+                return cache.Pop();
+            }
+
+            void Deallocate(void* ptr)
+            {
+                Block* block = static_cast<Block*>(ptr);
+
+                if (LocalCacheDestroyed())
+                {
+                    std::lock_guard<std::mutex> lock(_lock);
+                    _depot.Push(block);
+                    return;
+                }
+
+                LocalCache& cache = GetLocalCache();
+                cache.Push(block);
+
+                if (cache.Count > POOL_LOCAL_CACHE_SIZE)
+                    Flush(cache, POOL_LOCAL_CACHE_SIZE - POOL_TRANSFER_BATCH_SIZE);
+            }
+
+        private:
+            FixedBlockPool() = default;
+
+            static LocalCache& GetLocalCache()
+            {
+                thread_local LocalCache cache;
+                return cache;
+            }
+
+            // Trivially destructible, still readable while other thread_local objects are destroyed
+            static bool& LocalCacheDestroyed()
+            {
+                thread_local bool destroyed = false;
+                return destroyed;
+            }
+
+            void Refill(BlockList& local)
+            {
+                std::lock_guard<std::mutex> lock(_lock);
+
+                if (!_depot.Head)
+                    AllocateSlab();
+
+                for (std::size_t i = 0; i < POOL_TRANSFER_BATCH_SIZE && _depot.Head; ++i)
+                    local.Push(_depot.Pop());
+            }
+
+            void Flush(BlockList& local, std::size_t keep)
+            {
+                if (local.Count <= keep)
+                    return;
+
+                std::lock_guard<std::mutex> lock(_lock);
+
+                while (local.Count > keep)
+                    _depot.Push(local.Pop());
+            }
+
+            // Called with _lock held
+            void AllocateSlab()
+            {
+                std::size_t count = std::max<std::size_t>(PoolSlabSize<Tag>.load(std::memory_order_relaxed), 1);
+
+                // Value initialization touches every page of the slab up front
+                _slabs.emplace_back(std::make_unique<Block[]>(count));
+                Block* slab = _slabs.back().get();
+
+                for (std::size_t i = count; i > 0; --i)
+                    _depot.Push(&slab[i - 1]);
+            }
+
+            std::mutex _lock;
+            BlockList _depot;
+            std::vector<std::unique_ptr<Block[]>> _slabs;
+        };
+    }
+
+    // Stateless allocator taking single objects from a per-size free list pool.
+    // Meant for std::allocate_shared, so the object and its control block share one pooled block.
+    // Rebound allocators keep Tag, the control block comes from the pools of the allocator the caller named.
+    // Arrays are forwarded to std::allocator
+    template<typename T, typename Tag = T>
+    class PoolAllocator
+    {
+    public:
+        using value_type = T;
+
+        template<typename U>
+        struct rebind
+        {
+            using other = PoolAllocator<U, Tag>;
+        };
+
+        PoolAllocator() noexcept = default;
+
+        template<typename U>
+        PoolAllocator(PoolAllocator<U, Tag> const&) noexcept { }
+
+        T* allocate(std::size_t count)
+        {
+            if (count != 1)
+                return std::allocator<T>().allocate(count);
+
+            return static_cast<T*>(Impl::FixedBlockPool<sizeof(T), alignof(T), Tag>::Instance().Allocate());
+        }
+
+        void deallocate(T* ptr, std::size_t count) noexcept
+        {
+            if (count != 1)
+            {
+                std::allocator<T>().deallocate(ptr, count);
+                return;
+            }
+
+            Impl::FixedBlockPool<sizeof(T), alignof(T), Tag>::Instance().Deallocate(ptr);
+        }
+
+        // Number of objects allocated at once by the pools of Tag when they run empty
+        static void SetSlabSize(std::size_t count) { Impl::PoolSlabSize<Tag>.store(count, std::memory_order_relaxed); }
+    };
+
+    template<typename T, typename U, typename Tag>
+    inline bool operator==(PoolAllocator<T, Tag> const&, PoolAllocator<U, Tag> const&) noexcept { return true; }
+
+    template<typename T, typename U, typename Tag>
+    inline bool operator!=(PoolAllocator<T, Tag> const&, PoolAllocator<U, Tag> const&) noexcept { return false; }
+}
+
+#endif // _POOL_ALLOCATOR_H_
@@ -0,0 +1,64 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _SHARED_MESSAGE_BUFFER_H_
+#define _SHARED_MESSAGE_BUFFER_H_
+
+#include "MessageBuffer.h"
+#include <memory>
+#include <numeric>
+
+// Immutable, reference counted message payload. Encoded once and queued to any number of sockets
+// without copying, copies of SharedMessageBuffer only share ownership of the same bytes
+class SharedMessageBuffer
+{
+    struct Payload
+    {
+        explicit Payload(std::vector<uint8>&& storage) : Storage(std::move(storage)),
+            ByteSum(std::accumulate(Storage.begin(), Storage.end(), uint32(0))) { }
+
+        std::vector<uint8> const Storage;
+        uint32 const ByteSum;
+    };
+
+public:
+    SharedMessageBuffer() = default;
+
+    // Takes the active bytes of buffer
+    explicit SharedMessageBuffer(MessageBuffer&& buffer)
+    {
+        buffer.Normalize();
+
+        std::size_t size = buffer.GetActiveSize();
+        std::vector<uint8> storage = buffer.Move();
+        storage.resize(size);
+
+        _payload = std::make_shared<Payload const>(std::move(storage));
+    }
+
+    [[nodiscard]] uint8 const* GetData() const { return _payload ? _payload->Storage.data() : nullptr; }
+    [[nodiscard]] std::size_t GetSize() const { return _payload ? _payload->Storage.size() : 0; }
+    [[nodiscard]] bool IsEmpty() const { return GetSize() == 0; }
+
+    // Sum of all payload bytes, lets protocols checksum prefix + payload without reading the payload again
+    [[nodiscard]] uint32 GetByteSum() const { return _payload ? _payload->ByteSum : 0; }
+
+private:
+    std::shared_ptr<Payload const> _payload;
+};
+
+#endif // _SHARED_MESSAGE_BUFFER_H_
@@ -0,0 +1,363 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FixJournal.h"
+#include "Config.h"
+#include "Log.h"
+#include "ThreadPool.h"
+#include <boost/iostreams/device/mapped_file.hpp>
+#include <chrono>
+#include <cstring>
+#include <ctime>
+#include <filesystem>
+#include <future>
+#include <limits>
+#include <system_error>
+#include <fmt/chrono.h>
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+    // Smallest journal file. Records never span two files, records larger than a file are dropped
+    constexpr std::size_t MIN_FILE_SIZE = 1024 * 1024;
+
+    struct JournalFile
+    {
+        std::string Path;
+        boost::iostreams::mapped_file_sink File;
+    };
+
+    // New journal file of size bytes. Blocks are allocated up front where supported, a full disk fails here
+    // and not with SIGBUS on a later write to the mapping
+    JournalFile CreateJournalFile(std::string const& path, std::size_t size)
+    {
+        boost::iostreams::mapped_file_params params(path);
+        params.flags = boost::iostreams::mapped_file::readwrite;
+
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX
+        int fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0)
+            throw std::system_error(errno, std::generic_category(), "open");
+
+        int error = ::posix_fallocate(fd, 0, static_cast<off_t>(size));
+        ::close(fd);
+
+        if (error)
+            throw std::system_error(error, std::generic_category(), "posix_fallocate");
+#else
+        params.new_file_size = static_cast<boost::iostreams::stream_offset>(size);
+#endif
+
+        JournalFile file{ path, boost::iostreams::mapped_file_sink(params) };
+        std::memcpy(file.File.data(), FIX_JOURNAL_MAGIC, sizeof(FIX_JOURNAL_MAGIC));
+        return file;
+    }
+
+    // Unmap the file and cut the unused tail, one empty header stays as end marker. Files of a crashed process keep their full size
+    void CloseJournalFile(JournalFile& file, std::size_t size)
+    {
+        file.File.close();
+
+        std::error_code error;
+        std::filesystem::resize_file(file.Path, size + sizeof(FixJournalRecordHeader), error);
+    }
+
+    // Map every page writable, so writers take no page faults. Content is not changed, the file may be written meanwhile
+    void PrefaultJournalFile(boost::iostreams::mapped_file_sink const& file)
+    {
+#if WARHEAD_PLATFORM == WARHEAD_PLATFORM_UNIX && defined(MADV_POPULATE_WRITE)
+        if (file.is_open())
+            ::madvise(file.data(), file.size(), MADV_POPULATE_WRITE);
+#else
+        (void)file;
+#endif
+    }
+}
+
+struct FixJournal::Writer
+{
+    ~Writer()
+    {
+        if (_file.File.is_open())
+            CloseJournalFile(_file, _position);
+
+        // Prepared file was never written
+        if (_next.valid())
+        {
+            try
+            {
+                JournalFile next = _next.get();
+                next.File.close();
+
+                std::error_code error;
+                std::filesystem::remove(next.Path, error);
+            }
+            catch (std::exception const&) { }
+        }
+    }
+
+    // Contiguous space for size bytes, null if no file can take them
+    char* Reserve(std::size_t size)
+    {
+        // Keep room for the empty header ending the file
+        if (_file.File.is_open() && _position + size + sizeof(FixJournalRecordHeader) <= _file.File.size())
+            return _file.File.data() + _position;
+
+        if (size + sizeof(FIX_JOURNAL_MAGIC) + sizeof(FixJournalRecordHeader) > sFixJournal->_fileSize || !Rotate())
+        {
+            sFixJournal->_dropped.fetch_add(1, std::memory_order_relaxed);
+            return nullptr;
+        }
+
+        return _file.File.data() + _position;
+    }
+
+    void Commit(std::size_t size) { _position += size; }
+
+private:
+    bool Rotate()
+    {
+        // Unmapping and truncating a full file takes milliseconds, done on the journal thread
+        if (_file.File.is_open())
+        {
+            sFixJournal->_preparer->Post([file = _file, size = _position]() mutable
+            {
+                CloseJournalFile(file, size);
+            }, Warhead::TaskPriority::Low);
+
+            _file = JournalFile();
+        }
+
+        if (_id == INVALID_ID)
+            _id = sFixJournal->_nextWriterId.fetch_add(1, std::memory_order_relaxed);
+
+        try
+        {
+            // Next file is prepared in the background, only the first file of a thread is created here
+            if (_next.valid())
+                _file = _next.get();
+            else
+                _file = CreateJournalFile(GetNextPath(), sFixJournal->_fileSize);
+        }
+        catch (std::exception const& e)
+        {
+            if (!_failed)
+                LOG_ERROR("network", "FixJournal: Can't create journal file: {}", e.what());
+
+            _failed = true;
+            return false;
+        }
+
+        _position = sizeof(FIX_JOURNAL_MAGIC);
+        _failed = false;
+
+        PrepareNext();
+        return true;
+    }
+
+    // Prefault the current file and create the next one on the journal thread
+    void PrepareNext()
+    {
+        auto promise = std::make_shared<std::promise<JournalFile>>();
+        _next = promise->get_future();
+
+        sFixJournal->_preparer->Post([promise, current = _file.File, path = GetNextPath(), size = sFixJournal->_fileSize]()
+        {
+            PrefaultJournalFile(current);
+
+            try
+            {
+                JournalFile next = CreateJournalFile(path, size);
+                PrefaultJournalFile(next.File);
+                promise->set_value(std::move(next));
+            }
+            catch (std::exception const&)
+            {
+                promise->set_exception(std::current_exception());
+            }
+        }, Warhead::TaskPriority::Low);
+    }
+
+    std::string GetNextPath()
+    {
+        return fmt::format("{}{}_{:03}_{:05}.bin", sFixJournal->_directory, sFixJournal->_filePrefix, _id, _fileNumber++);
+    }
+
+    static constexpr uint32 INVALID_ID = std::numeric_limits<uint32>::max();
+
+    JournalFile _file;
+    std::future<JournalFile> _next;
+    std::size_t _position{ 0 };
+    uint32 _id{ INVALID_ID };
+    uint32 _fileNumber{ 0 };
+    bool _failed{ false };
+};
+
+FixJournal::FixJournal() = default;
+FixJournal::~FixJournal() = default;
+
+FixJournal* FixJournal::instance()
+{
+    static FixJournal instance;
+    return &instance;
+}
+
+void FixJournal::Initialize()
+{
+    _enabled = sConfigMgr->GetOption<bool>("FixJournal.Enable", false);
+    if (!_enabled)
+        return;
+
+    _directory = sConfigMgr->GetOption<std::string>("FixJournal.Dir", "");
+    if (_directory.empty())
+        _directory = sConfigMgr->GetOption<std::string>("LogsDir", "", false);
+
+    if (!_directory.empty() && _directory.back() != '/' && _directory.back() != '\\')
+        _directory.push_back('/');
+
+    _fileSize = std::size_t(sConfigMgr->GetOption<uint32>("FixJournal.FileSize", 64)) * 1024 * 1024;
+    if (_fileSize < MIN_FILE_SIZE)
+    {
+        LOG_ERROR("server", "FixJournal.FileSize can't be less than 1, set to 1");
+        _fileSize = MIN_FILE_SIZE;
+    }
+
+    // Start time keeps files of several runs apart, writer id and file number keep them in order
+    _filePrefix = fmt::format("FixJournal_{:%Y%m%d_%H%M%S}", fmt::localtime(std::time(nullptr)));
+
+    _preparer = std::make_unique<Warhead::ThreadPool>("FixJournal");
+    _preparer->Start(1);
+
+    LOG_INFO("server", "FixJournal: Writing raw FIX messages to {}{}_*.bin", _directory, _filePrefix);
+}
+
+FixJournal::Writer& FixJournal::GetWriter()
+{
+    thread_local Writer writer;
+    return writer;
+}
+
+void FixJournal::Write(FixJournalRecordType type, uint32 sessionId, uint32 msgSeqNum, std::initializer_list<boost::asio::const_buffer> data)
+{
+    std::size_t size = 0;
+    for (boost::asio::const_buffer const& part : data)
+        size += part.size();
+
+    Writer& writer = GetWriter();
+
+    char* out = writer.Reserve(sizeof(FixJournalRecordHeader) + size);
+    if (!out)
+        return;
+
+    FixJournalRecordHeader header{};
+    header.Size = static_cast<uint32>(size);
+    header.Type = type;
+    header.SessionId = sessionId;
+    header.MsgSeqNum = msgSeqNum;
+    header.Time = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+
+    std::memcpy(out, &header, sizeof(header));
+    out += sizeof(header);
+
+    for (boost::asio::const_buffer const& part : data)
+    {
+        std::memcpy(out, part.data(), part.size());
+        out += part.size();
+    }
+
+    writer.Commit(sizeof(FixJournalRecordHeader) + size);
+}
+
+void FixJournal::WriteInbound(uint32 sessionId, uint8 const* data, std::size_t size)
+{
+    while (size)
+    {
+        std::size_t length = FrameMessage(data, size);
+        if (!length)
+        {
+            Write(FixJournalRecordType::InboundFragment, sessionId, 0, { boost::asio::buffer(data, size) });
+            return;
+        }
+
+        Write(FixJournalRecordType::Inbound, sessionId, FindMsgSeqNum(data, length), { boost::asio::buffer(data, length) });
+        data += length;
+        size -= length;
+    }
+}
+
+std::size_t FixJournal::FrameMessage(uint8 const* data, std::size_t size)
+{
+    // 8=BeginString<SOH>9=BodyLength<SOH>, BodyLength bytes of body, then 10=nnn<SOH>
+    constexpr std::size_t checkSumLength = 7;
+
+    if (size < 2 || std::memcmp(data, "8=", 2) != 0)
+        return 0;
+
+    uint8 const* end = data + size;
+    uint8 const* beginStringEnd = static_cast<uint8 const*>(std::memchr(data, '\x01', size));
+    if (!beginStringEnd)
+        return 0;
+
+    uint8 const* field = beginStringEnd + 1;
+    if (end - field < 2 || std::memcmp(field, "9=", 2) != 0)
+        return 0;
+
+    std::size_t bodyLength = 0;
+    uint8 const* digit = field + 2;
+    for (; digit < end && *digit >= '0' && *digit <= '9'; ++digit)
+    {
+        bodyLength = bodyLength * 10 + (*digit - '0');
+        if (bodyLength > size)
+            return 0;
+    }
+
+    if (digit == field + 2 || digit == end || *digit != '\x01')
+        return 0;
+
+    std::size_t length = std::size_t(digit + 1 - data) + bodyLength + checkSumLength;
+    if (length > size || std::memcmp(data + length - checkSumLength, "10=", 3) != 0 || data[length - 1] != '\x01')
+        return 0;
+
+    return length;
+}
+
+uint32 FixJournal::FindMsgSeqNum(uint8 const* message, std::size_t size)
+{
+    // MsgSeqNum is part of the standard header, it's found within the first fields
+    constexpr char tag[] = "\x01" "34=";
+    constexpr std::size_t tagLength = sizeof(tag) - 1;
+
+    for (std::size_t i = 0; i + tagLength < size; ++i)
+    {
+        if (std::memcmp(message + i, tag, tagLength) != 0)
+            continue;
+
+        uint32 value = 0;
+        for (std::size_t j = i + tagLength; j < size && message[j] >= '0' && message[j] <= '9'; ++j)
+            value = value * 10 + (message[j] - '0');
+
+        return value;
+    }
+
+    return 0;
+}
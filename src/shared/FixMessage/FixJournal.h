@@ -0,0 +1,118 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _FIX_JOURNAL_H_
+#define _FIX_JOURNAL_H_
+
+#include "Define.h"
+#include <boost/asio/buffer.hpp>
+#include <atomic>
+#include <initializer_list>
+#include <memory>
+#include <string>
+
+namespace Warhead
+{
+    class ThreadPool;
+}
+
+// Audit journal of raw FIX messages. Every thread appends to memory mapped files of its own, no locks are taken.
+// Files are created with all blocks allocated and prefaulted by a background thread, writing a record is a memcpy.
+// Files start with FIX_JOURNAL_MAGIC, followed by records of FixJournalRecordHeader and Size bytes of message.
+// A record with Size 0 ends the file, files are rotated when the next record doesn't fit.
+// Host byte order, the fixjournal tool decodes and filters journal files
+constexpr char FIX_JOURNAL_MAGIC[8] = { 'W', 'H', 'F', 'I', 'X', 'J', '0', '1' };
+
+enum class FixJournalRecordType : uint8
+{
+    Inbound         = 1, // Message read from the session
+    Outbound        = 2, // Message queued to the session
+    SessionOpen     = 3, // Remote address of the session as "ip:port"
+    SessionClose    = 4,
+    InboundFragment = 5  // Bytes of a read not forming a complete message, a message cut by the read or garbage
+};
+
+struct FixJournalRecordHeader
+{
+    uint32 Size;
+    FixJournalRecordType Type;
+    uint8 Reserved[3];
+    uint32 SessionId;
+    uint32 MsgSeqNum;     // 0 if unknown
+    int64 Time;           // Nanoseconds since epoch
+};
+
+static_assert(sizeof(FixJournalRecordHeader) == 24, "Journal record header is part of the file format");
+
+class WH_SHARED_API FixJournal
+{
+    FixJournal();
+    ~FixJournal();
+    FixJournal(FixJournal const&) = delete;
+    FixJournal(FixJournal&&) = delete;
+    FixJournal& operator=(FixJournal const&) = delete;
+    FixJournal& operator=(FixJournal&&) = delete;
+
+public:
+    static FixJournal* instance();
+
+    // Reads FixJournal.* options, must be called before network threads start
+    void Initialize();
+
+    bool IsEnabled() const { return _enabled; }
+
+    // Id of a new session, unique within the process
+    uint32 NewSessionId() { return _nextSessionId.fetch_add(1, std::memory_order_relaxed); }
+
+    // Append one record, data is the message split in any number of parts. Only call if IsEnabled()
+    void Write(FixJournalRecordType type, uint32 sessionId, uint32 msgSeqNum, std::initializer_list<boost::asio::const_buffer> data);
+
+    // Splits data of one read into messages by BodyLength (9) and CheckSum (10), one Inbound record each.
+    // Whatever doesn't frame goes to a single InboundFragment record. Only call if IsEnabled()
+    void WriteInbound(uint32 sessionId, uint8 const* data, std::size_t size);
+
+    // Length of the complete message at the start of data, 0 if it is cut short or isn't a FIX message
+    static std::size_t FrameMessage(uint8 const* data, std::size_t size);
+
+    // MsgSeqNum (34) of a raw message, 0 if not found
+    static uint32 FindMsgSeqNum(uint8 const* message, std::size_t size);
+
+    // Records lost because a journal file couldn't be created or the record is larger than a file
+    uint64 GetDroppedCount() const { return _dropped.load(std::memory_order_relaxed); }
+
+private:
+    // Journal files of one thread
+    struct Writer;
+
+    Writer& GetWriter();
+
+    bool _enabled{ false };
+    std::string _directory;
+    std::string _filePrefix;
+    std::size_t _fileSize{ 0 };
+
+    // Creates and prefaults journal files ahead of the writers
+    std::unique_ptr<Warhead::ThreadPool> _preparer;
+
+    std::atomic<uint32> _nextSessionId{ 1 };
+    std::atomic<uint32> _nextWriterId{ 0 };
+    std::atomic<uint64> _dropped{ 0 };
+};
+
+#define sFixJournal FixJournal::instance()
+
+#endif // _FIX_JOURNAL_H_
@@ -20,8 +20,11 @@
 #include "Errors.h"
 #include "Log.h"
 #include "StopWatch.h"
+#include "StringFormat.h"
 #include <hffix.hpp>
 #include <map>
+#include <numeric>
+#include <vector>
 
 // We want Boost Date_Time support, so include these before hffix.hpp.
 #include <boost/date_time/posix_time/posix_time.hpp>
@@ -35,7 +38,9 @@ FixMessage* FixMessage::instance()
 
 bool FixMessage::IsReadLogonMessage(ByteBuffer& packet)
 {
+#if LOG_LEVEL_COMPILED(DEBUG)
     StopWatch sw;
+#endif
 
     std::map<int, std::string> field_dictionary;
     hffix::dictionary_init_field(field_dictionary);
@@ -91,14 +96,18 @@ bool FixMessage::IsReadLogonMessage(ByteBuffer& packet)
         return false;
     }
 
+#if LOG_LEVEL_COMPILED(DEBUG)
     LOG_DEBUG("fix.message", "> Read message in {}", sw);
+#endif
     LOG_INFO("fix.message", "");
     return true;
 }
 
 bool FixMessage::IsReadNewOrderSingleMessage(ByteBuffer& packet)
 {
+#if LOG_LEVEL_COMPILED(DEBUG)
     StopWatch sw;
+#endif
 
     std::map<int, std::string> field_dictionary;
     hffix::dictionary_init_field(field_dictionary);
@@ -148,7 +157,9 @@ bool FixMessage::IsReadNewOrderSingleMessage(ByteBuffer& packet)
         return false;
     }
 
+#if LOG_LEVEL_COMPILED(DEBUG)
     LOG_DEBUG("fix.message", "> Read message in {}", sw);
+#endif
     LOG_INFO("fix.message", "");
     return true;
 }
@@ -249,3 +260,73 @@ std::string FixMessage::GetCommand(ByteBuffer& packet)
 
     return "";
 }
+
+std::string FixMessage::GetSenderCompID(ByteBuffer& packet)
+{
+    const char* message = (const char*)packet.contents();
+    size_t length = packet.size();
+
+    hffix::message_reader reader(message, length);
+
+    hffix::message_reader::const_iterator i = reader.begin();
+    if (reader.is_valid() && reader.find_with_hint(hffix::tag::SenderCompID, i))
+        return i->value().as_string();
+
+    return "";
+}
+
+std::string FixMessage::GetTargetCompID(ByteBuffer& packet)
+{
+    const char* message = (const char*)packet.contents();
+    size_t length = packet.size();
+
+    hffix::message_reader reader(message, length);
+
+    hffix::message_reader::const_iterator i = reader.begin();
+    if (reader.is_valid() && reader.find_with_hint(hffix::tag::TargetCompID, i))
+        return i->value().as_string();
+
+    return "";
+}
+
+void FixMessage::WriteSessionFraming(FixSessionHeader const& header, SharedMessageBuffer const& body, MessageBuffer& prefix, MessageBuffer& suffix)
+{
+    // MsgType, CompIDs, MsgSeqNum and SendingTime, counted in BodyLength together with the shared body.
+    // Tag, '=' and SOH of 5 fields, up to 10 digits of MsgSeqNum and 21 characters of SendingTime besides the strings
+    constexpr std::size_t fixedFieldsSize = 5 * 8 + 10 + 21;
+
+    std::size_t fieldsCapacity = fixedFieldsSize + header.MsgType.size() + header.SenderCompID.size() + header.TargetCompID.size();
+
+    char stackFields[512];
+    std::vector<char> heapFields;
+    char* fields = stackFields;
+
+    if (fieldsCapacity > sizeof(stackFields))
+    {
+        heapFields.resize(fieldsCapacity);
+        fields = heapFields.data();
+    }
+
+    hffix::message_writer writer(fields, fieldsCapacity);
+
+    writer.push_back_string(hffix::tag::MsgType, header.MsgType.data(), header.MsgType.data() + header.MsgType.size());
+    writer.push_back_string(hffix::tag::SenderCompID, header.SenderCompID.data(), header.SenderCompID.data() + header.SenderCompID.size());
+    writer.push_back_string(hffix::tag::TargetCompID, header.TargetCompID.data(), header.TargetCompID.data() + header.TargetCompID.size());
+    writer.push_back_int(hffix::tag::MsgSeqNum, header.MsgSeqNum);
+    writer.push_back_timestamp(hffix::tag::SendingTime, std::chrono::time_point_cast<Milliseconds>(std::chrono::system_clock::now()));
+
+    std::size_t fieldsSize = writer.message_end() - fields;
+
+    std::string beginFields = Warhead::StringFormat("8={}\x01" "9={}\x01", header.BeginString, fieldsSize + body.GetSize());
+
+    prefix = MessageBuffer(beginFields.size() + fieldsSize);
+    prefix.Write(beginFields.data(), beginFields.size());
+    prefix.Write(fields, fieldsSize);
+
+    uint32 checksum = std::accumulate(prefix.GetReadPointer(), prefix.GetWritePointer(), body.GetByteSum());
+
+    std::string trailer = Warhead::StringFormat("10={:03}\x01", checksum % 256);
+
+    suffix = MessageBuffer(trailer.size());
+    suffix.Write(trailer.data(), trailer.size());
+}
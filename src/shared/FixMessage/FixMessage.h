@@ -19,9 +19,24 @@
 #define __FIX_MESSAGE_H__
 
 #include "ByteBuffer.h"
+#include "MessageBuffer.h"
+#include "SharedMessageBuffer.h"
 #include <memory>
 #include <string_view>
 
+// Longest SenderCompID and TargetCompID a session accepts at Logon
+constexpr std::size_t FIX_MAX_COMP_ID_LENGTH = 64;
+
+// Standard header fields that differ per session
+struct FixSessionHeader
+{
+    std::string_view BeginString;
+    std::string_view MsgType;
+    std::string_view SenderCompID;
+    std::string_view TargetCompID;
+    uint32 MsgSeqNum{ 0 };
+};
+
 class WH_SHARED_API FixMessage
 {
     FixMessage() = default;
@@ -37,9 +52,15 @@ public:
     void PrepareTestMessage(ByteBuffer& packet);
     bool IsValidCommand(ByteBuffer& packet, std::string_view command);
     std::string GetCommand(ByteBuffer& packet);
+    std::string GetSenderCompID(ByteBuffer& packet);
+    std::string GetTargetCompID(ByteBuffer& packet);
 
     bool IsReadLogonMessage(ByteBuffer& packet);
     bool IsReadNewOrderSingleMessage(ByteBuffer& packet);
+
+    // Encode the standard header (prefix) and CheckSum trailer (suffix) of one session for a body shared by many sessions.
+    // Body holds the fields after the standard header, it is only read through its precomputed byte sum
+    void WriteSessionFraming(FixSessionHeader const& header, SharedMessageBuffer const& body, MessageBuffer& prefix, MessageBuffer& suffix);
 };
 
 #define sFixMessage FixMessage::instance()
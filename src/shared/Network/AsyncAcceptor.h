@@ -70,7 +70,8 @@ public:
         });
     }
 
-    bool Bind()
+    // reusePort allows several acceptors to listen on the same endpoint, the kernel spreads incoming connections between them
+    bool Bind(bool reusePort = false)
     {
         boost::system::error_code errorCode;
         _acceptor.open(_endpoint.protocol(), errorCode);
@@ -89,6 +90,21 @@ public:
         }
 #endif
 
+        if (reusePort)
+        {
+#ifdef SO_REUSEPORT
+            _acceptor.set_option(boost::asio::detail::socket_option::boolean<SOL_SOCKET, SO_REUSEPORT>(true), errorCode);
+            if (errorCode)
+            {
+                LOG_INFO("network", "Failed to set reuse_port option on acceptor {}", errorCode.message());
+                return false;
+            }
+#else
+            LOG_INFO("network", "SO_REUSEPORT is not supported on this platform");
+            return false;
+#endif
+        }
+
         _acceptor.bind(_endpoint, errorCode);
         if (errorCode)
         {
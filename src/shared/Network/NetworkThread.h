@@ -23,17 +23,37 @@
 #include "Errors.h"
 #include "IoContext.h"
 #include "Log.h"
+#include "MPSCQueue.h"
+#include "ThreadUtils.h"
 #include "Timer.h"
+#include <algorithm>
 #include <atomic>
 #include <boost/asio/ip/tcp.hpp>
 #include <chrono>
 #include <memory>
-#include <mutex>
 #include <set>
+#include <string>
 #include <thread>
+#include <vector>
 
 using boost::asio::ip::tcp;
 
+enum class NetworkSpinMode : uint8
+{
+    Block,      // Sleep in io_context::run until there is work
+    Spin,       // Busy loop on io_context::poll, never sleeps
+    Adaptive,   // Busy loop, fall back to blocking after idle time without work
+
+    Max
+};
+
+// Load of a network thread over the last second
+struct NetworkThreadLoad
+{
+    uint32 MessagesPerSecond{ 0 };
+    std::chrono::nanoseconds BusyTime{ 0 }; // Time spent in read handlers and socket updates
+};
+
 template<class SocketType>
 class NetworkThread
 {
@@ -81,30 +101,114 @@ public:
         return _connections;
     }
 
+    // Called from acceptor threads. Socket is handed over without locking, the network thread is woken up to take it
     virtual void AddSocket(std::shared_ptr<SocketType> sock)
     {
-        std::lock_guard<std::mutex> lock(_newSocketsLock);
-
         ++_connections;
-        _newSockets.push_back(sock);
         SocketAdded(sock);
+
+        _newSockets.Enqueue(new NewSocket(std::move(sock)));
+
+        // One wakeup for all sockets queued until the network thread starts taking them
+        if (!_newSocketsPending.exchange(true, std::memory_order_acq_rel))
+            Warhead::Asio::post(_ioContext, [this]() { AddNewSockets(); });
+    }
+
+    // Calls fn for every open socket of this thread, from the network thread itself
+    template<typename Fn>
+    void PostForEachSocket(Fn&& fn)
+    {
+        Warhead::Asio::post(_ioContext, [this, fn = std::forward<Fn>(fn)]()
+        {
+            AddNewSockets();
+
+            for (std::shared_ptr<SocketType> const& sock : _sockets)
+                if (sock->IsOpen())
+                    fn(sock);
+        });
+    }
+
+    NetworkThreadLoad GetLoad() const
+    {
+        NetworkThreadLoad load;
+        load.MessagesPerSecond = _messagesPerSecond.load(std::memory_order_relaxed);
+        load.BusyTime = std::chrono::nanoseconds(_busyTimePerSecond.load(std::memory_order_relaxed));
+        return load;
+    }
+
+    // Move the busiest session whose busy time is not above maxBusyTime to target.
+    // Sessions are picked by the load of the last window, migration itself runs on this thread
+    void PostMigrateSession(NetworkThread& target, std::chrono::nanoseconds maxBusyTime)
+    {
+        Warhead::Asio::post(_ioContext, [this, &target, maxBusyTime]()
+        {
+            auto selected = _sockets.end();
+
+            for (auto itr = _sockets.begin(); itr != _sockets.end(); ++itr)
+            {
+                std::chrono::nanoseconds busyTime = (*itr)->GetLoad().BusyTime;
+                if (busyTime > maxBusyTime || !(*itr)->IsOpen() || (*itr)->IsPinned())
+                    continue;
+
+                if (selected == _sockets.end() || busyTime > (*selected)->GetLoad().BusyTime)
+                    selected = itr;
+            }
+
+            if (selected == _sockets.end() || (*selected)->GetLoad().BusyTime == std::chrono::nanoseconds::zero())
+                return;
+
+            LOG_DEBUG("network", "Network thread '{}' moves session {}:{} to '{}' ({} messages/s)", _name, (*selected)->GetRemoteIpAddress().to_string(),
+                (*selected)->GetRemotePort(), target._name, (*selected)->GetLoad().Messages);
+
+            MoveSession(selected, target);
+        });
+    }
+
+    // Move sock to target as soon as it has no write in flight. Called from any thread, sock must belong to this thread
+    void PostMoveSession(std::shared_ptr<SocketType> sock, NetworkThread& target)
+    {
+        if (&target == this)
+            return;
+
+        Warhead::Asio::post(_ioContext, [this, sock = std::move(sock), &target]() mutable
+        {
+            _pendingMoves.push_back({ std::move(sock), &target, 0 });
+            ProcessPendingMoves();
+        });
     }
 
     tcp::socket* GetSocketForAccept() { return &_acceptSocket; }
+    Warhead::Asio::IoContext& GetIoContext() { return _ioContext; }
+
+    // Must be set before Start(), applied by the thread itself when Run() begins
+    void SetName(std::string_view name) { _name = name; }
+    void SetCpuAffinity(int32 cpu) { _cpuAffinity = cpu; }
+    void SetNumaNode(int32 node) { _numaNode = node; }
+    void SetSpinMode(NetworkSpinMode mode, Microseconds idleTime) { _spinMode = mode; _spinIdleTime = idleTime; }
 
 protected:
+    // Called from the thread the socket leaves, reading continues on this thread
+    void AddMigratedSocket(std::shared_ptr<SocketType> sock)
+    {
+        AddSocket(sock);
+        Warhead::Asio::post(_ioContext, [sock]() { sock->AsyncRead(); });
+    }
+
     virtual void SocketAdded(std::shared_ptr<SocketType> /*sock*/) { }
     virtual void SocketRemoved(std::shared_ptr<SocketType> /*sock*/) { }
 
     void AddNewSockets()
     {
-        std::lock_guard<std::mutex> lock(_newSocketsLock);
-
-        if (_newSockets.empty())
+        // Cleared before taking sockets, a socket queued meanwhile posts a new wakeup
+        if (!_newSocketsPending.exchange(false, std::memory_order_acq_rel))
             return;
 
-        for (std::shared_ptr<SocketType> sock : _newSockets)
+        NewSocket* newSocket;
+        while (_newSockets.Dequeue(newSocket))
         {
+            std::shared_ptr<SocketType> sock = std::move(newSocket->Socket);
+            delete newSocket;
+
             if (!sock->IsOpen())
             {
                 SocketRemoved(sock);
@@ -113,32 +217,92 @@ protected:
             else
                 _sockets.push_back(sock);
         }
+    }
+
+    void ApplyThreadSettings()
+    {
+        if (!_name.empty())
+            Warhead::Thread::SetCurrentThreadName(_name);
 
-        _newSockets.clear();
+        if (_cpuAffinity >= 0 && Warhead::Thread::SetCurrentThreadAffinity(_cpuAffinity))
+            LOG_INFO("network", "Network thread '{}' pinned to cpu {}", _name, _cpuAffinity);
+
+        if (_numaNode >= 0 && Warhead::Thread::SetCurrentThreadNumaNode(_numaNode, _cpuAffinity >= 0))
+            LOG_INFO("network", "Network thread '{}' bound to NUMA node {}", _name, _numaNode);
     }
 
     void Run()
     {
+        ApplyThreadSettings();
+
         LOG_DEBUG("network", "Network Thread Starting");
 
+        _loadWindowStart = std::chrono::steady_clock::now();
+
         _updateTimer.expires_from_now(boost::posix_time::milliseconds(1));
         _updateTimer.async_wait([this](boost::system::error_code const&) { Update(); });
-        _ioContext.run();
+
+        if (_spinMode == NetworkSpinMode::Block)
+            _ioContext.run();
+        else
+            RunSpin();
 
         LOG_DEBUG("network", "Network Thread exits");
-        _newSockets.clear();
+
+        NewSocket* newSocket;
+        while (_newSockets.Dequeue(newSocket))
+            delete newSocket;
+
+        // Sockets must go before the io_context they are registered with
         _sockets.clear();
+        _pendingMoves.clear();
+    }
+
+    // Low latency loop for pinned threads, avoids futex/epoll_wait sleep on every wakeup
+    void RunSpin()
+    {
+        using clock = std::chrono::steady_clock;
+
+        LOG_DEBUG("network", "Network Thread uses {} spin mode", _spinMode == NetworkSpinMode::Spin ? "busy" : "adaptive");
+
+        clock::time_point lastWork = clock::now();
+
+        while (!_stopped && !_ioContext.stopped())
+        {
+            // Update timer fires every 1 ms, its tick is not socket work and must not keep the thread spinning
+            uint32 updates = _updateCount;
+            if (_ioContext.poll() > _updateCount - updates)
+            {
+                lastWork = clock::now();
+                continue;
+            }
+
+            if (_spinMode != NetworkSpinMode::Adaptive)
+                continue;
+
+            // Nothing to do for a while - block until next event. Update timer wakes thread at least every 1 ms
+            if (clock::now() - lastWork >= _spinIdleTime)
+            {
+                updates = _updateCount;
+                if (_ioContext.run_one() > _updateCount - updates)
+                    lastWork = clock::now();
+            }
+        }
     }
 
     void Update()
     {
+        ++_updateCount;
+
         if (_stopped)
             return;
 
         _updateTimer.expires_from_now(boost::posix_time::milliseconds(1));
         _updateTimer.async_wait([this](boost::system::error_code const&) { Update(); });
 
-        AddNewSockets();
+        TimePoint start = std::chrono::steady_clock::now();
+        if (start - _loadWindowStart >= LOAD_WINDOW)
+            UpdateLoad(start);
 
         _sockets.erase(std::remove_if(_sockets.begin(), _sockets.end(), [this](std::shared_ptr<SocketType> sock)
         {
@@ -155,20 +319,116 @@ protected:
 
             return false;
         }), _sockets.end());
+
+        // Sockets with an empty write queue can leave now
+        if (!_pendingMoves.empty())
+            ProcessPendingMoves();
+
+        _updateBusyTime += std::chrono::steady_clock::now() - start;
+    }
+
+    void UpdateLoad(TimePoint now)
+    {
+        uint64 messages = 0;
+        std::chrono::nanoseconds busyTime = _updateBusyTime;
+
+        for (std::shared_ptr<SocketType> const& sock : _sockets)
+        {
+            sock->UpdateLoad();
+            messages += sock->GetLoad().Messages;
+            busyTime += sock->GetLoad().BusyTime;
+        }
+
+        // Scale to one second, the update timer does not fire exactly on the window end
+        double scale = double(std::chrono::duration_cast<std::chrono::nanoseconds>(LOAD_WINDOW).count()) /
+            std::chrono::duration_cast<std::chrono::nanoseconds>(now - _loadWindowStart).count();
+
+        _messagesPerSecond.store(uint32(messages * scale), std::memory_order_relaxed);
+        _busyTimePerSecond.store(int64(busyTime.count() * scale), std::memory_order_relaxed);
+
+        _updateBusyTime = std::chrono::nanoseconds::zero();
+        _loadWindowStart = now;
     }
 
 private:
     typedef std::vector<std::shared_ptr<SocketType>> SocketContainer;
 
+    static constexpr Seconds LOAD_WINDOW = 1s;
+
+    // Updates a move waits for its socket to show up in this thread and for its writes to drain before it is dropped
+    static constexpr uint32 MAX_PENDING_MOVE_ATTEMPTS = 1000;
+
+    struct PendingMove
+    {
+        std::shared_ptr<SocketType> Socket;
+        NetworkThread* Target;
+        uint32 Attempts;
+    };
+
+    bool MoveSession(typename SocketContainer::iterator itr, NetworkThread& target)
+    {
+        std::shared_ptr<SocketType> sock = *itr;
+        if (!sock->StartMigration(target.GetIoContext(), [&target](std::shared_ptr<SocketType> migrated) { target.AddMigratedSocket(std::move(migrated)); }))
+            return false;
+
+        _sockets.erase(itr);
+        SocketRemoved(sock);
+        --_connections;
+        return true;
+    }
+
+    void ProcessPendingMoves()
+    {
+        _pendingMoves.erase(std::remove_if(_pendingMoves.begin(), _pendingMoves.end(), [this](PendingMove& move)
+        {
+            if (!move.Socket->IsOpen())
+                return true;
+
+            auto itr = std::find(_sockets.begin(), _sockets.end(), move.Socket);
+            if (itr != _sockets.end() && MoveSession(itr, *move.Target))
+                return true;
+
+            // Not taken from the new socket queue yet, write still in flight or already moved elsewhere
+            if (++move.Attempts < MAX_PENDING_MOVE_ATTEMPTS)
+                return false;
+
+            LOG_DEBUG("network", "Network thread '{}' gives up moving session {}:{} to '{}'", _name, move.Socket->GetRemoteIpAddress().to_string(),
+                move.Socket->GetRemotePort(), move.Target->_name);
+            return true;
+        }), _pendingMoves.end());
+    }
+
+    struct NewSocket
+    {
+        explicit NewSocket(std::shared_ptr<SocketType>&& sock) : Socket(std::move(sock)) { }
+
+        std::shared_ptr<SocketType> Socket;
+        std::atomic<NewSocket*> QueueLink;
+    };
+
     std::atomic<int32> _connections;
     std::atomic<bool> _stopped;
 
     std::thread* _thread;
 
+    std::string _name;
+    int32 _cpuAffinity{ -1 };
+    int32 _numaNode{ -1 };
+    NetworkSpinMode _spinMode{ NetworkSpinMode::Block };
+    Microseconds _spinIdleTime{ 0 };
+    uint32 _updateCount{ 0 }; // Update timer ticks, only touched by the thread itself
+
     SocketContainer _sockets;
 
-    std::mutex _newSocketsLock;
-    SocketContainer _newSockets;
+    std::vector<PendingMove> _pendingMoves;
+
+    TimePoint _loadWindowStart;
+    std::chrono::nanoseconds _updateBusyTime{ 0 };
+    std::atomic<uint32> _messagesPerSecond{ 0 };
+    std::atomic<int64> _busyTimePerSecond{ 0 };
+
+    MPSCQueue<NewSocket, &NewSocket::QueueLink> _newSockets;
+    std::atomic<bool> _newSocketsPending{ false };
 
     Warhead::Asio::IoContext _ioContext;
     tcp::socket _acceptSocket;
@@ -18,31 +18,114 @@
 #ifndef __SOCKET_H__
 #define __SOCKET_H__
 
+#include "Duration.h"
+#include "HandlerAllocator.h"
 #include "Log.h"
 #include "MessageBuffer.h"
+#include "MessageBufferPool.h"
+#include "MirroredMessageBuffer.h"
+#include "SessionTask.h"
+#include "SocketWriteBuffer.h"
+#include <algorithm>
 #include <atomic>
+#include <boost/asio/execution/context.hpp>
 #include <boost/asio/ip/tcp.hpp>
+#include <boost/asio/post.hpp>
+#include <boost/asio/query.hpp>
 #include <functional>
 #include <memory>
 #include <queue>
 #include <type_traits>
+#include <utility>
 
 using boost::asio::ip::tcp;
 
 constexpr auto READ_BLOCK_SIZE = 4096;
 
-#ifdef BOOST_ASIO_HAS_IOCP
+// Completion based backends (IOCP, io_uring) write queued buffers with async_write_some,
+// reactor based ones write synchronously and wait for writability only when the socket would block
+#if defined(BOOST_ASIO_HAS_IOCP) || (defined(BOOST_ASIO_HAS_IO_URING) && defined(BOOST_ASIO_DISABLE_EPOLL))
 #define WH_SOCKET_USE_IOCP
 #endif
 
-template<class T>
+// Adaptive read buffer sizing. Reads filling the whole buffer double its size up to MaxSize,
+// after ShrinkIdleTime without such reads the buffer goes back to MinSize
+struct SocketReadBufferSettings
+{
+    std::size_t MinSize{ READ_BLOCK_SIZE };
+    std::size_t MaxSize{ 256 * 1024 };
+    Milliseconds ShrinkIdleTime{ 1000 };
+};
+
+// Read load of one socket, measured by the owning network thread over its load window
+struct SocketLoad
+{
+    uint32 Messages{ 0 };                   // Reads handed to ReadHandler
+    std::chrono::nanoseconds BusyTime{ 0 }; // Time spent in ReadHandler
+};
+
+// How a socket gets storage for its read buffer and gives it back while the socket is idle
+template<class ReadBufferType>
+struct SocketReadBuffer;
+
+// Chunks are borrowed from sMessageBufferPool when data arrives and returned once the socket is idle
+template<>
+struct SocketReadBuffer<MessageBuffer>
+{
+    static constexpr bool ReleaseWhenIdle = true;
+
+    static MessageBuffer Create() { return MessageBuffer(std::vector<uint8>()); }
+
+    // Switch to storage for size bytes, unread data is kept. Nothing is done if unread data does not fit
+    static void Acquire(MessageBuffer& buffer, std::size_t size)
+    {
+        std::size_t storageSize = MessageBufferPool::GetStorageSize(size);
+        if (buffer.GetBufferSize() == storageSize || buffer.GetActiveSize() > storageSize)
+            return;
+
+        MessageBuffer resized(sMessageBufferPool->Acquire(size));
+        resized.Write(buffer.GetReadPointer(), buffer.GetActiveSize());
+
+        sMessageBufferPool->Release(buffer.Move());
+        buffer = std::move(resized);
+    }
+
+    static void Release(MessageBuffer& buffer) { sMessageBufferPool->Release(buffer.Move()); }
+};
+
+// Mapping is created on first read and only replaced by a bigger one, it never shrinks and is not given back
+// while the socket is idle, mapping setup is too expensive to repeat
+template<>
+struct SocketReadBuffer<MirroredMessageBuffer>
+{
+    static constexpr bool ReleaseWhenIdle = false;
+
+    static MirroredMessageBuffer Create() { return MirroredMessageBuffer(); }
+
+    static void Acquire(MirroredMessageBuffer& buffer, std::size_t size)
+    {
+        if (buffer.GetBufferSize() < size)
+            buffer.Resize(size);
+    }
+
+    static void Release(MirroredMessageBuffer& /*buffer*/) { }
+};
+
+// ReadBufferType is MessageBuffer or MirroredMessageBuffer. The latter never moves unread data,
+// it suits sessions receiving large or pipelined messages that straddle reads
+template<class T, class ReadBufferType = MessageBuffer>
 class Socket : public std::enable_shared_from_this<T>
 {
 public:
     explicit Socket(tcp::socket&& socket) : _socket(std::move(socket)), _remoteAddress(_socket.remote_endpoint().address()),
-        _remotePort(_socket.remote_endpoint().port()), _readBuffer(), _closed(false), _closing(false), _isWritingAsync(false)
+        _remotePort(_socket.remote_endpoint().port()), _readBuffer(SocketReadBuffer<ReadBufferType>::Create()), _readSize(_readBufferSettings.MinSize), _readHandlerMemory(Warhead::Asio::HandlerMemory::Create()),
+        _writeHandlerMemory(Warhead::Asio::HandlerMemory::Create()), _closed(false), _closing(false), _isWritingAsync(false), _pinned(false)
     {
-        _readBuffer.Resize(READ_BLOCK_SIZE);
+#ifndef WH_SOCKET_USE_IOCP
+        // Reads are done synchronously after readiness notification, they must never block the network thread
+        boost::system::error_code error;
+        _socket.non_blocking(true, error);
+#endif
     }
 
     virtual ~Socket()
@@ -50,6 +133,8 @@ public:
         _closed = true;
         boost::system::error_code error;
         _socket.close(error);
+
+        SocketReadBuffer<ReadBufferType>::Release(_readBuffer);
     }
 
     virtual void Start() = 0;
@@ -59,12 +144,20 @@ public:
         if (_closed)
             return false;
 
+        if (_readSize > _readBufferSettings.MinSize)
+            ShrinkReadBufferIfIdle();
+
 #ifndef WH_SOCKET_USE_IOCP
+        if constexpr (SocketReadBuffer<ReadBufferType>::ReleaseWhenIdle)
+            ReleaseReadBufferIfIdle();
+
         if (_isWritingAsync || (_writeQueue.empty() && !_closing))
             return true;
 
         for (; HandleQueue();)
             ;
+
+        ResumeWriteWaiter();
 #endif
 
         return true;
@@ -85,26 +178,103 @@ public:
         if (!IsOpen())
             return;
 
-        _readBuffer.Normalize();
-        _readBuffer.EnsureFreeSpace();
+#ifndef WH_SOCKET_USE_IOCP
+        // Read chain is at a safe point, no operation is pending
+        if (_migration)
+        {
+            FinishMigration();
+            return;
+        }
+
+        // Idle sockets hold no read buffer, storage is borrowed from the pool again when data arrives.
+        // Active ones keep reading speculatively, a readiness wait first would cost a reactor round trip per message
+        if (SocketReadBuffer<ReadBufferType>::ReleaseWhenIdle && _readIdle && !_readBuffer.GetActiveSize())
+        {
+            SocketReadBuffer<ReadBufferType>::Release(_readBuffer);
+            _socket.async_wait(tcp::socket::wait_read, MakeChainHandler(*_readHandlerMemory, &Socket::_readOwner, &Socket::ReadReadyHandler));
+            return;
+        }
+#endif
+
+        PrepareReadBuffer();
         _socket.async_read_some(boost::asio::buffer(_readBuffer.GetWritePointer(), _readBuffer.GetRemainingSpace()),
-            std::bind(&Socket<T>::ReadHandlerInternal, this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            MakeChainHandler(*_readHandlerMemory, &Socket::_readOwner, &Socket::ReadHandlerInternal));
+    }
+
+#ifdef WARHEAD_WITH_COROUTINES
+
+    // co_await NextMessage() resumes the session coroutine once a read completed, data is in GetReadBuffer().
+    // Result is false when the socket is closed, the coroutine should return.
+    // One read is one message, as for ReadHandler(). Only the session coroutine may wait for a message
+    auto NextMessage()
+    {
+        struct Awaiter
+        {
+            Socket& Owner;
+
+            bool await_ready() const noexcept { return !Owner.IsOpen(); }
+
+            void await_suspend(std::coroutine_handle<> handle)
+            {
+                Owner._readWaiter = handle;
+                Owner.AsyncRead();
+            }
+
+            bool await_resume() const noexcept { return Owner.IsOpen(); }
+        };
+
+        return Awaiter{ *this };
+    }
+
+    // co_await Send(buffer) queues buffer like QueuePacket. The session coroutine is suspended only while
+    // the write queue holds more than MaxQueuedSends buffers, until the queue is empty.
+    // Result is false when the socket is closed. A coroutine still suspended on close is destroyed with the socket
+    auto Send(MessageBuffer&& buffer)
+    {
+        QueuePacket(std::move(buffer));
+
+        struct Awaiter
+        {
+            Socket& Owner;
+
+            bool await_ready() const noexcept { return !Owner.IsOpen() || Owner._writeQueue.size() <= MaxQueuedSends; }
+            void await_suspend(std::coroutine_handle<> handle) noexcept { Owner._writeWaiter = handle; }
+            bool await_resume() const noexcept { return Owner.IsOpen(); }
+        };
+
+        return Awaiter{ *this };
     }
 
+    // Frame of the session coroutine is allocated here when it is a member function of T
+    Warhead::Asio::FrameMemory& GetFrameMemory() { return _frameMemory; }
+
+    static constexpr std::size_t MaxQueuedSends = 64;
+
+#endif
+
     void AsyncReadWithCallback(void (T::*callback)(boost::system::error_code, std::size_t))
     {
         if (!IsOpen())
             return;
 
-        _readBuffer.Normalize();
-        _readBuffer.EnsureFreeSpace();
+        PrepareReadBuffer();
         _socket.async_read_some(boost::asio::buffer(_readBuffer.GetWritePointer(), _readBuffer.GetRemainingSpace()),
-            std::bind(callback, this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+            Warhead::Asio::BindHandlerMemory(*_readHandlerMemory, std::bind(callback, this->shared_from_this(), std::placeholders::_1, std::placeholders::_2)));
     }
 
     void QueuePacket(MessageBuffer&& buffer)
     {
-        _writeQueue.push(std::move(buffer));
+        _writeQueue.emplace(std::move(buffer));
+
+#ifdef WH_SOCKET_USE_IOCP
+        AsyncProcessQueue();
+#endif
+    }
+
+    // Payload is shared with other sockets and never copied, only prefix and suffix belong to this socket
+    void QueuePacket(MessageBuffer&& prefix, SharedMessageBuffer const& payload, MessageBuffer&& suffix)
+    {
+        _writeQueue.emplace(std::move(prefix), payload, std::move(suffix));
 
 #ifdef WH_SOCKET_USE_IOCP
         AsyncProcessQueue();
@@ -113,6 +283,51 @@ public:
 
     bool IsOpen() const { return !_closed && !_closing; }
 
+    // True if completion handlers of this socket run on context
+    bool IsBoundTo(boost::asio::io_context& context)
+    {
+        return &boost::asio::query(_socket.get_executor(), boost::asio::execution::context) == &context;
+    }
+
+    // Pinned sockets were placed on their network thread on purpose, load balancing leaves them there
+    void SetPinned(bool pinned) { _pinned = pinned; }
+    bool IsPinned() const { return _pinned; }
+
+    // Load of the last window, only valid on the owning network thread
+    SocketLoad const& GetLoad() const { return _load; }
+
+    // Close the current load window, called by the owning network thread
+    void UpdateLoad()
+    {
+        _load = _loadCounter;
+        _loadCounter = SocketLoad();
+    }
+
+    using MigrationCallback = std::function<void(std::shared_ptr<T>)>;
+
+    // Move the socket to the io_context of another network thread. Called from the owning network thread,
+    // the socket is handed over at the next safe point of its read chain. onMigrated runs on the old thread
+    // once the socket is registered with target, the new owner restarts reading with AsyncRead().
+    // Fails while a write is in flight. Completion backends cannot hand over pending native operations
+    bool StartMigration(boost::asio::io_context& target, MigrationCallback onMigrated)
+    {
+#ifdef WH_SOCKET_USE_IOCP
+        (void)target;
+        (void)onMigrated;
+        return false;
+#else
+        if (!IsOpen() || _migration || _isWritingAsync || !_writeQueue.empty())
+            return false;
+
+        _migration = std::make_unique<Migration>(Migration{ &target, std::move(onMigrated) });
+
+        // Pending readiness wait or read completes with operation_aborted
+        boost::system::error_code error;
+        _socket.cancel(error);
+        return true;
+#endif
+    }
+
     void CloseSocket()
     {
         if (_closed.exchange(true))
@@ -131,12 +346,24 @@ public:
     /// Marks the socket for closing after write buffer becomes empty
     void DelayedCloseSocket() { _closing = true; }
 
-    MessageBuffer& GetReadBuffer() { return _readBuffer; }
+    ReadBufferType& GetReadBuffer() { return _readBuffer; }
+
+    // Must be set before any socket of this type is created
+    static void SetReadBufferSettings(SocketReadBufferSettings const& settings) { _readBufferSettings = settings; }
 
 protected:
     virtual void OnClose() { }
     virtual void ReadHandler() = 0;
 
+#ifdef WARHEAD_WITH_COROUTINES
+    // Take ownership of the session coroutine and run it until its first co_await. Reads then resume it instead of calling ReadHandler()
+    void RunSession(Warhead::Asio::SessionTask&& task)
+    {
+        _session = std::move(task);
+        _session.Resume();
+    }
+#endif
+
     bool AsyncProcessQueue()
     {
         if (_isWritingAsync)
@@ -145,12 +372,10 @@ protected:
         _isWritingAsync = true;
 
 #ifdef WH_SOCKET_USE_IOCP
-        MessageBuffer& buffer = _writeQueue.front();
-        _socket.async_write_some(boost::asio::buffer(buffer.GetReadPointer(), buffer.GetActiveSize()), std::bind(&Socket<T>::WriteHandler,
-            this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+        SocketWriteBuffer& buffer = _writeQueue.front();
+        _socket.async_write_some(buffer.GetBuffers(), MakeChainHandler(*_writeHandlerMemory, &Socket::_writeOwner, &Socket::WriteHandler));
 #else
-        _socket.async_write_some(boost::asio::null_buffers(), std::bind(&Socket<T>::WriteHandlerWrapper,
-            this->shared_from_this(), std::placeholders::_1, std::placeholders::_2));
+        _socket.async_write_some(boost::asio::null_buffers(), MakeChainHandler(*_writeHandlerMemory, &Socket::_writeOwner, &Socket::WriteHandlerWrapper));
 #endif
 
         return false;
@@ -167,18 +392,228 @@ protected:
     }
 
 private:
+    // Completion handler of the read or write chain, allocated from the chain's handler memory.
+    // While fn runs the socket reference is parked in owner, so the next operation of the chain
+    // takes it over instead of another shared_from_this() and release pair
+    template<typename Fn>
+    auto MakeChainHandler(Warhead::Asio::HandlerMemory& memory, std::shared_ptr<T> Socket::* owner, Fn fn)
+    {
+        std::shared_ptr<T> self = this->*owner ? std::move(this->*owner) : this->shared_from_this();
+
+        return Warhead::Asio::BindHandlerMemory(memory, [self = std::move(self), owner, fn](auto... args) mutable
+        {
+            Socket& socket = *self;
+            socket.*owner = std::move(self);
+            (socket.*fn)(args...);
+
+            // Chain did not continue, drop the reference
+            std::shared_ptr<T> last = std::move(socket.*owner);
+        });
+    }
+
+    void PrepareReadBuffer()
+    {
+        _readBuffer.Normalize();
+
+        // Unread data fills the whole buffer, grow regardless of the size limit or the message never completes
+        if (_readBuffer.GetBufferSize() && !_readBuffer.GetRemainingSpace())
+        {
+            _readSize = std::max(_readSize, _readBuffer.GetBufferSize() * 2);
+            _lastReadTime = std::chrono::steady_clock::now();
+        }
+
+        SocketReadBuffer<ReadBufferType>::Acquire(_readBuffer, _readSize);
+
+        _readSpace = _readBuffer.GetRemainingSpace();
+    }
+
+    void ShrinkReadBufferIfIdle()
+    {
+        if (std::chrono::steady_clock::now() - _lastReadTime < _readBufferSettings.ShrinkIdleTime)
+            return;
+
+        // Storage is never switched here, a read with unread data in the buffer is pending on it on every backend.
+        // The next PrepareReadBuffer applies the smaller size. Sockets waiting for readiness hold no storage at all
+        _readSize = _readBufferSettings.MinSize;
+    }
+
+#ifndef WH_SOCKET_USE_IOCP
+
+    // Socket without data for ShrinkIdleTime gives its empty read buffer back. The pending speculative read is
+    // cancelled, its handler continues the read chain with a readiness wait that holds no storage
+    void ReleaseReadBufferIfIdle()
+    {
+        if (!_readIdle)
+        {
+            if (std::chrono::steady_clock::now() - _lastDataTime < _readBufferSettings.ShrinkIdleTime)
+                return;
+
+            _readIdle = true;
+        }
+
+        // Read of the rest of a message keeps its storage. Cancel would also abort a pending write readiness wait
+        if (!_readBuffer.GetBufferSize() || _readBuffer.GetActiveSize() || _idleReadCancelled || _migration || _isWritingAsync)
+            return;
+
+        _idleReadCancelled = true;
+
+        boost::system::error_code error;
+        _socket.cancel(error);
+    }
+
+#endif
+
+#ifndef WH_SOCKET_USE_IOCP
+
+    void ReadReadyHandler(boost::system::error_code error)
+    {
+        if (error == boost::asio::error::operation_aborted && _migration)
+        {
+            FinishMigration();
+            return;
+        }
+
+        if (error)
+        {
+            CloseSocket();
+            ResumeReadWaiter();
+            return;
+        }
+
+        PrepareReadBuffer();
+
+        std::size_t transferredBytes = _socket.read_some(boost::asio::buffer(_readBuffer.GetWritePointer(), _readBuffer.GetRemainingSpace()), error);
+        if (error == boost::asio::error::would_block || error == boost::asio::error::try_again)
+        {
+            AsyncRead();
+            return;
+        }
+
+        ReadHandlerInternal(error, transferredBytes);
+    }
+
+#endif
+
     void ReadHandlerInternal(boost::system::error_code error, size_t transferredBytes)
     {
+#ifndef WH_SOCKET_USE_IOCP
+        bool idleReadCancelled = std::exchange(_idleReadCancelled, false);
+
+        // Read of the rest of a partial message was pending, unread data moves along with the socket
+        if (error == boost::asio::error::operation_aborted && _migration)
+        {
+            FinishMigration();
+            return;
+        }
+
+        // Speculative read of an idle socket, the read chain goes on without storage
+        if (error == boost::asio::error::operation_aborted && idleReadCancelled)
+        {
+            AsyncRead();
+            return;
+        }
+#endif
+
         if (error)
         {
             CloseSocket();
+            ResumeReadWaiter();
             return;
         }
 
+        TimePoint start = std::chrono::steady_clock::now();
+        _lastDataTime = start;
+        _readIdle = false;
+
+        // Read took all offered space, more data is likely waiting. Use bigger reads for the rest of the burst
+        if (transferredBytes == _readSpace)
+        {
+            _readSize = std::min(_readSize * 2, std::max(_readBufferSettings.MaxSize, _readSize));
+            _lastReadTime = start;
+        }
+
         _readBuffer.WriteCompleted(transferredBytes);
-        ReadHandler();
+
+        if (!ResumeReadWaiter())
+            ReadHandler();
+
+        ++_loadCounter.Messages;
+        _loadCounter.BusyTime += std::chrono::steady_clock::now() - start;
+    }
+
+    // Returns false if no session coroutine waits for a read
+    bool ResumeReadWaiter()
+    {
+#ifdef WARHEAD_WITH_COROUTINES
+        if (!_readWaiter)
+            return false;
+
+        std::exchange(_readWaiter, nullptr).resume();
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    // Session coroutine waits in Send() for the write queue to drain
+    void ResumeWriteWaiter()
+    {
+#ifdef WARHEAD_WITH_COROUTINES
+        if (_writeWaiter && _writeQueue.empty())
+            std::exchange(_writeWaiter, nullptr).resume();
+#endif
+    }
+
+#ifndef WH_SOCKET_USE_IOCP
+
+    void FinishMigration()
+    {
+        std::unique_ptr<Migration> migration = std::move(_migration);
+
+        boost::system::error_code error;
+        tcp protocol = _socket.local_endpoint(error).protocol();
+        if (error)
+        {
+            CloseSocket();
+            return;
+        }
+
+        auto source = _socket.get_executor();
+
+        // Deregister from the old reactor and register the same descriptor with target
+        tcp::socket migrated(*migration->Target);
+        tcp::socket::native_handle_type handle = _socket.release(error);
+        if (!error)
+        {
+            migrated.assign(protocol, handle, error);
+            if (error)
+            {
+                boost::system::error_code ignored;
+                _socket.assign(protocol, handle, ignored);
+            }
+        }
+
+        if (error)
+        {
+            LOG_ERROR("network", "Socket::FinishMigration: failed to move socket of {} to another network thread: {} ({})",
+                GetRemoteIpAddress().to_string(), error.value(), error.message());
+            CloseSocket();
+            return;
+        }
+
+        migrated.non_blocking(true, error);
+        _socket = std::move(migrated);
+
+        // Hand over only after the read chain of the old thread has unwound, the new thread may start reading right away
+        std::shared_ptr<T> self = _readOwner ? std::move(_readOwner) : this->shared_from_this();
+        boost::asio::post(source, [self = std::move(self), onMigrated = std::move(migration->OnMigrated)]() mutable
+        {
+            onMigrated(std::move(self));
+        });
     }
 
+#endif
+
 #ifdef WH_SOCKET_USE_IOCP
 
     void WriteHandler(boost::system::error_code error, std::size_t transferedBytes)
@@ -195,6 +630,8 @@ private:
                 AsyncProcessQueue();
             else if (_closing)
                 CloseSocket();
+            else
+                ResumeWriteWaiter();
         }
         else
             CloseSocket();
@@ -206,6 +643,7 @@ private:
     {
         _isWritingAsync = false;
         HandleQueue();
+        ResumeWriteWaiter();
     }
 
     bool HandleQueue()
@@ -213,12 +651,12 @@ private:
         if (_writeQueue.empty())
             return false;
 
-        MessageBuffer& queuedMessage = _writeQueue.front();
+        SocketWriteBuffer& queuedMessage = _writeQueue.front();
 
         std::size_t bytesToSend = queuedMessage.GetActiveSize();
 
         boost::system::error_code error;
-        std::size_t bytesSent = _socket.write_some(boost::asio::buffer(queuedMessage.GetReadPointer(), bytesToSend), error);
+        std::size_t bytesSent = _socket.write_some(queuedMessage.GetBuffers(), error);
 
         if (error)
         {
@@ -259,13 +697,46 @@ private:
     boost::asio::ip::address _remoteAddress;
     uint16 _remotePort;
 
-    MessageBuffer _readBuffer;
-    std::queue<MessageBuffer> _writeQueue;
+    ReadBufferType _readBuffer; // Storage is obtained through SocketReadBuffer on first read
+    std::size_t _readSize;
+    std::size_t _readSpace{ 0 };
+    TimePoint _lastReadTime;
+    TimePoint _lastDataTime;   // Last read that returned data
+    bool _readIdle{ true };    // No data for ShrinkIdleTime, reads wait for readiness without holding storage
+    bool _idleReadCancelled{ false };
+    std::queue<SocketWriteBuffer> _writeQueue;
+
+    Warhead::Asio::HandlerMemoryPtr _readHandlerMemory;
+    Warhead::Asio::HandlerMemoryPtr _writeHandlerMemory;
+    std::shared_ptr<T> _readOwner;
+    std::shared_ptr<T> _writeOwner;
+
+    SocketLoad _load;
+    SocketLoad _loadCounter;
+
+    struct Migration
+    {
+        boost::asio::io_context* Target;
+        MigrationCallback OnMigrated;
+    };
+
+    std::unique_ptr<Migration> _migration;
+
+#ifdef WARHEAD_WITH_COROUTINES
+    // Frame memory must outlive the frame, keep it declared before _session
+    Warhead::Asio::FrameMemory _frameMemory;
+    Warhead::Asio::SessionTask _session;
+    std::coroutine_handle<> _readWaiter;
+    std::coroutine_handle<> _writeWaiter;
+#endif
 
     std::atomic<bool> _closed;
     std::atomic<bool> _closing;
 
     bool _isWritingAsync;
+    bool _pinned;
+
+    static inline SocketReadBufferSettings _readBufferSettings;
 };
 
 #endif // __SOCKET_H__
@@ -19,13 +19,33 @@
 #define SocketMgr_h__
 
 #include "AsyncAcceptor.h"
+#include "Config.h"
+#include "DeadlineTimer.h"
 #include "Errors.h"
 #include "NetworkThread.h"
+#include "PoolAllocator.h"
+#include "Socket.h"
+#include "StringConvert.h"
+#include "Tokenize.h"
 #include <boost/asio/ip/tcp.hpp>
 #include <memory>
+#include <optional>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
 
 using boost::asio::ip::tcp;
 
+// Network thread of a session once its CompID is known (after Logon)
+enum class SessionPlacementPolicy : uint8
+{
+    LeastConnections,   // Stay on the thread chosen at accept time
+    CompIDHash,         // Thread picked by a stable hash of the CompID
+    Mapping,            // Thread listed for the CompID in Network.Placement.Mapping
+
+    Max
+};
+
 template<class SocketType>
 class SocketMgr
 {
@@ -39,41 +59,130 @@ public:
     {
         ASSERT(threadCount > 0);
 
-        AsyncAcceptor* acceptor = nullptr;
-        try
+        bool reusePort = sConfigMgr->GetOption<bool>("Network.ReusePort", false);
+
+        if (!reusePort)
         {
-            acceptor = new AsyncAcceptor(ioContext, bindIp, port);
+            _acceptor = CreateAcceptor(ioContext, bindIp, port, false);
+            if (!_acceptor)
+                return false;
         }
-        catch (boost::system::system_error const& err)
+
+        _threadCount = threadCount;
+        _threads = CreateThreads();
+
+        ASSERT(_threads);
+
+        // One listening socket per network thread, each thread accepts on its own io_context
+        if (reusePort)
         {
-            LOG_ERROR("network", "Exception caught in SocketMgr.StartNetwork ({}:{}): {}", bindIp, port, err.what());
-            return false;
+            for (int32 i = 0; i < _threadCount; ++i)
+            {
+                AsyncAcceptor* acceptor = CreateAcceptor(_threads[i].GetIoContext(), bindIp, port, true);
+                if (!acceptor)
+                {
+                    for (AsyncAcceptor* threadAcceptor : _threadAcceptors)
+                        delete threadAcceptor;
+
+                    _threadAcceptors.clear();
+                    delete[] _threads;
+                    _threads = nullptr;
+                    _threadCount = 0;
+                    return false;
+                }
+
+                acceptor->SetSocketFactory([this, i]() { return std::make_pair(_threads[i].GetSocketForAccept(), uint32(i)); });
+                _threadAcceptors.push_back(acceptor);
+            }
+
+            LOG_INFO("network", "Network uses {} SO_REUSEPORT acceptors, one per network thread", _threadCount);
         }
 
-        if (!acceptor->Bind())
+        // One entry per network thread, -1 or missing entry - not set
+        std::vector<int32> cpuAffinity = ParseThreadOption("Network.Threads.CpuAffinity");
+        std::vector<int32> numaNodes = ParseThreadOption("Network.Threads.NumaNode");
+
+        uint8 spinMode = sConfigMgr->GetOption<uint8>("Network.Threads.SpinMode", 0);
+        if (spinMode >= static_cast<uint8>(NetworkSpinMode::Max))
         {
-            LOG_ERROR("network", "StartNetwork failed to bind socket acceptor");
-            delete acceptor;
-            return false;
+            LOG_ERROR("network", "Bad value {} in option Network.Threads.SpinMode, use 0", spinMode);
+            spinMode = 0;
         }
 
-        _acceptor = acceptor;
-        _threadCount = threadCount;
-        _threads = CreateThreads();
+        Microseconds spinIdleTime(sConfigMgr->GetOption<uint32>("Network.Threads.SpinIdleTime", 1000));
+        _socketBusyPoll = sConfigMgr->GetOption<int32>("Network.SocketBusyPoll", 0);
+        if (_socketBusyPoll > 0 && !CheckSocketBusyPoll(ioContext))
+            _socketBusyPoll = 0;
 
-        ASSERT(_threads);
+        // Pre-warm read buffers, session objects are allocated by slabs of the same size
+        _sessionPoolSize = sConfigMgr->GetOption<uint32>("Network.SessionPool.Size", 1024);
+        if (_sessionPoolSize)
+        {
+            Warhead::PoolAllocator<SocketType>::SetSlabSize(_sessionPoolSize);
+            sMessageBufferPool->Reserve(_sessionPoolSize);
+        }
+
+        SocketReadBufferSettings readBufferSettings;
+        readBufferSettings.MinSize = sConfigMgr->GetOption<uint32>("Network.ReadBuffer.MinSize", READ_BLOCK_SIZE);
+        readBufferSettings.MaxSize = sConfigMgr->GetOption<uint32>("Network.ReadBuffer.MaxSize", 256 * 1024);
+        readBufferSettings.ShrinkIdleTime = Milliseconds(sConfigMgr->GetOption<uint32>("Network.ReadBuffer.ShrinkIdleTime", 1000));
+
+        if (!readBufferSettings.MinSize || readBufferSettings.MaxSize < readBufferSettings.MinSize)
+        {
+            LOG_ERROR("network", "Network.ReadBuffer.MinSize ({}) must be above 0 and not above Network.ReadBuffer.MaxSize ({}), using defaults",
+                readBufferSettings.MinSize, readBufferSettings.MaxSize);
+            readBufferSettings = SocketReadBufferSettings();
+        }
+
+        SocketType::SetReadBufferSettings(readBufferSettings);
+
+        LoadPlacementSettings();
 
         for (int32 i = 0; i < _threadCount; ++i)
+        {
+            _threads[i].SetName(Warhead::StringFormat("Network {}", i));
+
+            if (i < int32(cpuAffinity.size()))
+                _threads[i].SetCpuAffinity(cpuAffinity[i]);
+
+            if (i < int32(numaNodes.size()))
+                _threads[i].SetNumaNode(numaNodes[i]);
+
+            _threads[i].SetSpinMode(static_cast<NetworkSpinMode>(spinMode), spinIdleTime);
+
             _threads[i].Start();
+        }
+
+        if (_acceptor)
+            _acceptor->SetSocketFactory([this]() { return GetSocketForAccept(); });
+
+        _rebalanceInterval = Seconds(sConfigMgr->GetOption<uint32>("Network.Rebalance.Interval", 10));
+        _rebalanceThreshold = Milliseconds(10 * sConfigMgr->GetOption<uint32>("Network.Rebalance.Threshold", 25));
 
-        _acceptor->SetSocketFactory([this]() { return GetSocketForAccept(); });
+        if (_threadCount > 1 && _rebalanceInterval > Seconds::zero())
+        {
+#ifdef WH_SOCKET_USE_IOCP
+            LOG_WARN("network", "Network.Rebalance.Interval is set, but sessions can't be moved between network threads on this platform");
+#else
+            _rebalanceTimer = new Warhead::Asio::DeadlineTimer(ioContext);
+            ScheduleRebalance();
+#endif
+        }
 
         return true;
     }
 
     virtual void StopNetwork()
     {
-        _acceptor->Close();
+        if (_acceptor)
+            _acceptor->Close();
+
+        if (_rebalanceTimer)
+        {
+            _rebalanceTimer->cancel();
+            delete _rebalanceTimer;
+            _rebalanceTimer = nullptr;
+        }
 
         if (_threadCount != 0)
             for (int32 i = 0; i < _threadCount; ++i)
@@ -81,6 +190,21 @@ public:
 
         Wait();
 
+        // Per thread acceptors belong to io_context of network threads, close them only after threads are stopped
+        for (AsyncAcceptor* acceptor : _threadAcceptors)
+        {
+            acceptor->Close();
+            delete acceptor;
+        }
+
+        _threadAcceptors.clear();
+
+#if LOG_LEVEL_COMPILED(INFO)
+        MessageBufferPoolStats poolStats = sMessageBufferPool->GetStats();
+        LOG_INFO("network", "Network::StopNetwork: Read buffer pool: {} local hits, {} shared hits, {} misses, {} returns, {} drops",
+            poolStats.LocalHits, poolStats.SharedHits, poolStats.Misses, poolStats.Returns, poolStats.Drops);
+#endif
+
         delete _acceptor;
         _acceptor = nullptr;
         delete[] _threads;
@@ -88,6 +212,31 @@ public:
         _threadCount = 0;
     }
 
+    // Calls fn(std::shared_ptr<SocketType> const&) for every open socket, each network thread visits its own sockets
+    template<typename Fn>
+    void ForEachSocket(Fn const& fn)
+    {
+        for (int32 i = 0; i < _threadCount; ++i)
+            _threads[i].PostForEachSocket(fn);
+    }
+
+    template<AsyncAcceptor::AcceptCallback acceptCallback>
+    void AsyncAcceptWithCallback()
+    {
+        if (_acceptor)
+        {
+            _acceptor->AsyncAcceptWithCallback<acceptCallback>();
+            return;
+        }
+
+        // Start accepting from the thread owning the acceptor
+        for (int32 i = 0; i < _threadCount; ++i)
+        {
+            AsyncAcceptor* acceptor = _threadAcceptors[i];
+            Warhead::Asio::post(_threads[i].GetIoContext(), [acceptor]() { acceptor->AsyncAcceptWithCallback<acceptCallback>(); });
+        }
+    }
+
     void Wait()
     {
         if (_threadCount != 0)
@@ -97,9 +246,22 @@ public:
 
     virtual void OnSocketOpen(tcp::socket&& sock, uint32 threadIndex)
     {
+#ifdef SO_BUSY_POLL
+        // Busy poll the device queue on blocking reads instead of waiting for interrupt
+        if (_socketBusyPoll > 0)
+        {
+            boost::system::error_code err;
+            sock.set_option(boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>(_socketBusyPoll), err);
+            if (err)
+                LOG_DEBUG("network", "SocketMgr::OnSocketOpen sock.set_option(SO_BUSY_POLL) err = {}", err.message());
+        }
+#endif
+
         try
         {
-            std::shared_ptr<SocketType> newSocket = std::make_shared<SocketType>(std::move(sock));
+            std::shared_ptr<SocketType> newSocket = _sessionPoolSize ?
+                std::allocate_shared<SocketType>(Warhead::PoolAllocator<SocketType>(), std::move(sock)) :
+                std::make_shared<SocketType>(std::move(sock));
             newSocket->Start();
 
             _threads[threadIndex].AddSocket(newSocket);
@@ -129,15 +291,226 @@ public:
         return std::make_pair(_threads[threadIndex].GetSocketForAccept(), threadIndex);
     }
 
+    // Move the session to the network thread of its CompID. Called from the thread owning the session
+    void PlaceSession(std::shared_ptr<SocketType> const& sock, std::string_view compId)
+    {
+        int32 target = SelectThreadForCompID(compId);
+        if (target < 0)
+            return;
+
+        // Stay on the thread picked for the CompID even if another thread gets less busy
+        sock->SetPinned(true);
+
+        for (int32 i = 0; i < _threadCount; ++i)
+        {
+            if (!sock->IsBoundTo(_threads[i].GetIoContext()))
+                continue;
+
+            if (i != target)
+            {
+                LOG_DEBUG("network", "Network::PlaceSession: {}:{} CompID '{}' moves from thread {} to {}", sock->GetRemoteIpAddress().to_string(),
+                    sock->GetRemotePort(), compId, i, target);
+
+                _threads[i].PostMoveSession(sock, _threads[target]);
+            }
+
+            return;
+        }
+    }
+
+    // Move one session from the busiest to the idlest network thread if their load differs by more than the threshold.
+    // Connection counts don't tell how busy a thread is, a few sessions can produce most of the traffic
+    void Rebalance()
+    {
+        int32 busiest = 0;
+        int32 idlest = 0;
+
+        for (int32 i = 1; i < _threadCount; ++i)
+        {
+            if (_threads[i].GetLoad().BusyTime > _threads[busiest].GetLoad().BusyTime)
+                busiest = i;
+
+            if (_threads[i].GetLoad().BusyTime < _threads[idlest].GetLoad().BusyTime)
+                idlest = i;
+        }
+
+        NetworkThreadLoad busiestLoad = _threads[busiest].GetLoad();
+        NetworkThreadLoad idlestLoad = _threads[idlest].GetLoad();
+
+        std::chrono::nanoseconds difference = busiestLoad.BusyTime - idlestLoad.BusyTime;
+        if (busiest == idlest || difference < _rebalanceThreshold)
+            return;
+
+        LOG_DEBUG("network", "Network::Rebalance: thread {} busy {}us/s ({} messages/s), thread {} busy {}us/s ({} messages/s)",
+            busiest, std::chrono::duration_cast<Microseconds>(busiestLoad.BusyTime).count(), busiestLoad.MessagesPerSecond,
+            idlest, std::chrono::duration_cast<Microseconds>(idlestLoad.BusyTime).count(), idlestLoad.MessagesPerSecond);
+
+        // A session heavier than half the difference would only swap the roles of both threads
+        _threads[busiest].PostMigrateSession(_threads[idlest], difference / 2);
+    }
+
 protected:
     SocketMgr() :
-        _acceptor(nullptr), _threads(nullptr), _threadCount(0) { }
+        _acceptor(nullptr), _threads(nullptr), _threadCount(0), _socketBusyPoll(0), _sessionPoolSize(0),
+        _rebalanceTimer(nullptr), _rebalanceInterval(0), _rebalanceThreshold(0) { }
 
     virtual NetworkThread<SocketType>* CreateThreads() const = 0;
 
+    // Network thread index for the CompID, -1 to keep the session where it is
+    virtual int32 SelectThreadForCompID(std::string_view compId) const
+    {
+        switch (_placementPolicy)
+        {
+            case SessionPlacementPolicy::CompIDHash:
+                return int32(HashCompID(compId) % uint32(_threadCount));
+            case SessionPlacementPolicy::Mapping:
+            {
+                auto itr = _placementMapping.find(std::string(compId));
+                return itr != _placementMapping.end() ? itr->second : -1;
+            }
+            default:
+                return -1;
+        }
+    }
+
+    // FNV-1a, same value on every build and platform so other components can compute the placement too
+    static uint32 HashCompID(std::string_view compId)
+    {
+        uint32 hash = 2166136261u;
+
+        for (char c : compId)
+        {
+            hash ^= uint8(c);
+            hash *= 16777619u;
+        }
+
+        return hash;
+    }
+
+    void LoadPlacementSettings()
+    {
+        uint8 policy = sConfigMgr->GetOption<uint8>("Network.Placement.Policy", 0);
+        if (policy >= static_cast<uint8>(SessionPlacementPolicy::Max))
+        {
+            LOG_ERROR("network", "Bad value {} in option Network.Placement.Policy, use 0", policy);
+            policy = 0;
+        }
+
+        _placementPolicy = static_cast<SessionPlacementPolicy>(policy);
+        _placementMapping.clear();
+
+        if (_placementPolicy != SessionPlacementPolicy::Mapping)
+            return;
+
+        // "CompID:thread CompID:thread"
+        std::string const& option = sConfigMgr->GetOption<std::string>("Network.Placement.Mapping", "");
+
+        for (auto const& entry : Warhead::Tokenize(option, ' ', false))
+        {
+            auto const& tokens = Warhead::Tokenize(entry, ':', false);
+            std::optional<int32> thread = tokens.size() == 2 ? Warhead::StringTo<int32>(tokens[1]) : std::nullopt;
+
+            if (!thread || *thread < 0 || *thread >= _threadCount)
+            {
+                LOG_ERROR("network", "Bad entry '{}' in option Network.Placement.Mapping, skip it", entry);
+                continue;
+            }
+
+            _placementMapping[std::string(tokens[0])] = *thread;
+        }
+    }
+
+    static AsyncAcceptor* CreateAcceptor(Warhead::Asio::IoContext& ioContext, std::string const& bindIp, uint16 port, bool reusePort)
+    {
+        AsyncAcceptor* acceptor = nullptr;
+        try
+        {
+            acceptor = new AsyncAcceptor(ioContext, bindIp, port);
+        }
+        catch (boost::system::system_error const& err)
+        {
+            LOG_ERROR("network", "Exception caught in SocketMgr.StartNetwork ({}:{}): {}", bindIp, port, err.what());
+            return nullptr;
+        }
+
+        if (!acceptor->Bind(reusePort))
+        {
+            LOG_ERROR("network", "StartNetwork failed to bind socket acceptor");
+            delete acceptor;
+            return nullptr;
+        }
+
+        return acceptor;
+    }
+
+    static std::vector<int32> ParseThreadOption(std::string const& optionName)
+    {
+        std::string const& option = sConfigMgr->GetOption<std::string>(optionName, "");
+        std::vector<int32> values;
+
+        for (auto const& token : Warhead::Tokenize(option, ' ', false))
+        {
+            auto value = Warhead::StringTo<int32>(token);
+            if (!value)
+            {
+                LOG_ERROR("network", "Bad value '{}' in option {}, skip it", token, optionName);
+                values.push_back(-1);
+                continue;
+            }
+
+            values.push_back(*value);
+        }
+
+        return values;
+    }
+
     AsyncAcceptor* _acceptor;
+    std::vector<AsyncAcceptor*> _threadAcceptors;
     NetworkThread<SocketType>* _threads;
     int32 _threadCount;
+    int32 _socketBusyPoll;
+    uint32 _sessionPoolSize;
+    SessionPlacementPolicy _placementPolicy{ SessionPlacementPolicy::LeastConnections };
+    std::unordered_map<std::string, int32> _placementMapping;
+
+private:
+    // Setting SO_BUSY_POLL may require CAP_NET_ADMIN. Try once on a probe socket instead of failing for every accepted one
+    bool CheckSocketBusyPoll(boost::asio::io_context& ioContext)
+    {
+#ifdef SO_BUSY_POLL
+        boost::system::error_code err;
+        tcp::socket probe(ioContext);
+        probe.open(tcp::v4(), err);
+        if (!err)
+            probe.set_option(boost::asio::detail::socket_option::integer<SOL_SOCKET, SO_BUSY_POLL>(_socketBusyPoll), err);
+
+        if (!err)
+            return true;
+
+        LOG_WARN("network", "Network.SocketBusyPoll is set, but SO_BUSY_POLL can't be set on sockets ({}). Busy polling is disabled", err.message());
+#else
+        (void)ioContext;
+        LOG_WARN("network", "Network.SocketBusyPoll is set, but SO_BUSY_POLL is not supported on this platform");
+#endif
+        return false;
+    }
+
+    void ScheduleRebalance()
+    {
+        _rebalanceTimer->expires_from_now(boost::posix_time::seconds(_rebalanceInterval.count()));
+        _rebalanceTimer->async_wait([this](boost::system::error_code const& error)
+        {
+            if (error)
+                return;
+
+            Rebalance();
+            ScheduleRebalance();
+        });
+    }
+
+    Warhead::Asio::DeadlineTimer* _rebalanceTimer;
+    Seconds _rebalanceInterval;
+    std::chrono::nanoseconds _rebalanceThreshold;
 };
 
 #endif // SocketMgr_h__
@@ -0,0 +1,75 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __SOCKET_WRITE_BUFFER_H__
+#define __SOCKET_WRITE_BUFFER_H__
+
+#include "MessageBuffer.h"
+#include "SharedMessageBuffer.h"
+#include <algorithm>
+#include <array>
+#include <boost/asio/buffer.hpp>
+
+// Entry of the socket write queue: owned prefix, optional shared payload and owned suffix, sent with one gathered write.
+// Plain packets only use the prefix
+class SocketWriteBuffer
+{
+public:
+    using BufferSequence = std::array<boost::asio::const_buffer, 3>;
+
+    explicit SocketWriteBuffer(MessageBuffer&& buffer) : _prefix(std::move(buffer)), _suffix(std::size_t(0)) { }
+
+    SocketWriteBuffer(MessageBuffer&& prefix, SharedMessageBuffer payload, MessageBuffer&& suffix) :
+        _prefix(std::move(prefix)), _payload(std::move(payload)), _suffix(std::move(suffix)) { }
+
+    // Unsent bytes of all three parts, empty parts are zero sized buffers
+    BufferSequence GetBuffers()
+    {
+        return
+        {
+            boost::asio::const_buffer(_prefix.GetReadPointer(), _prefix.GetActiveSize()),
+            boost::asio::const_buffer(_payload.GetData() + _payloadPos, _payload.GetSize() - _payloadPos),
+            boost::asio::const_buffer(_suffix.GetReadPointer(), _suffix.GetActiveSize())
+        };
+    }
+
+    [[nodiscard]] std::size_t GetActiveSize() const
+    {
+        return _prefix.GetActiveSize() + (_payload.GetSize() - _payloadPos) + _suffix.GetActiveSize();
+    }
+
+    void ReadCompleted(std::size_t bytes)
+    {
+        std::size_t prefixBytes = std::min(bytes, _prefix.GetActiveSize());
+        _prefix.ReadCompleted(prefixBytes);
+        bytes -= prefixBytes;
+
+        std::size_t payloadBytes = std::min(bytes, _payload.GetSize() - _payloadPos);
+        _payloadPos += payloadBytes;
+        bytes -= payloadBytes;
+
+        _suffix.ReadCompleted(bytes);
+    }
+
+private:
+    MessageBuffer _prefix;
+    SharedMessageBuffer _payload;
+    std::size_t _payloadPos{ 0 };
+    MessageBuffer _suffix;
+};
+
+#endif // __SOCKET_WRITE_BUFFER_H__
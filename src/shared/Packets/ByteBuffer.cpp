@@ -152,6 +152,7 @@ void ByteBuffer::put(size_t pos, uint8 const* src, size_t cnt)
 
 void ByteBuffer::print_storage() const
 {
+#if LOG_LEVEL_COMPILED(TRACE)
     std::ostringstream o;
     o << "STORAGE_SIZE: " << size();
 
@@ -161,10 +162,12 @@ void ByteBuffer::print_storage() const
     o << " ";
 
     LOG_TRACE("network.buffer", "{}", o.str());
+#endif
 }
 
 void ByteBuffer::textlike() const
 {
+#if LOG_LEVEL_COMPILED(TRACE)
     std::ostringstream o;
     o << "STORAGE_SIZE: " << size();
 
@@ -174,10 +177,12 @@ void ByteBuffer::textlike() const
     o << " ";
 
     LOG_TRACE("network.buffer", "{}", o.str());
+#endif
 }
 
 void ByteBuffer::hexlike() const
 {
+#if LOG_LEVEL_COMPILED(TRACE)
     uint32 j = 1, k = 1;
 
     std::ostringstream o;
@@ -205,4 +210,5 @@ void ByteBuffer::hexlike() const
     o << " ";
 
     LOG_TRACE("network.buffer", "{}", o.str());
+#endif
 }
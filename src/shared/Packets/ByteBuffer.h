@@ -531,6 +531,7 @@ public:
 
     void AppendPackedTime(time_t time);
     void put(size_t pos, const uint8 *src, size_t cnt);
+    // Trace log of the contents, do nothing when trace logging is compiled out
     void print_storage() const;
     void textlike() const;
     void hexlike() const;
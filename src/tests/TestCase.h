@@ -0,0 +1,64 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _TEST_CASE_H_
+#define _TEST_CASE_H_
+
+#include <fmt/format.h>
+#include <stdexcept>
+#include <string>
+
+// Minimal test harness. TEST_CASE functions register themselves, TestMain.cpp runs all of them
+// (or the ones named on the command line) and returns non-zero if a CHECK failed
+namespace Warhead::Test
+{
+    using TestFunction = void(*)();
+
+    struct TestFailure : std::runtime_error
+    {
+        using std::runtime_error::runtime_error;
+    };
+
+    bool RegisterTest(char const* name, TestFunction function);
+
+    [[noreturn]] inline void Fail(char const* file, int line, std::string const& message)
+    {
+        throw TestFailure(fmt::format("{}:{}: {}", file, line, message));
+    }
+}
+
+#define TEST_CASE(name__) \
+    static void name__(); \
+    static bool const name__##Registered = Warhead::Test::RegisterTest(#name__, &name__); \
+    static void name__()
+
+#define CHECK(expr__) \
+    do { \
+        if (!(expr__)) \
+            Warhead::Test::Fail(__FILE__, __LINE__, "CHECK(" #expr__ ") failed"); \
+    } while (0)
+
+// Both values must be formattable with fmt
+#define CHECK_EQUAL(left__, right__) \
+    do { \
+        auto const& checkLeft__ = (left__); \
+        auto const& checkRight__ = (right__); \
+        if (!(checkLeft__ == checkRight__)) \
+            Warhead::Test::Fail(__FILE__, __LINE__, fmt::format("CHECK_EQUAL(" #left__ ", " #right__ ") failed: {} != {}", checkLeft__, checkRight__)); \
+    } while (0)
+
+#endif // _TEST_CASE_H_
@@ -0,0 +1,66 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "TestCase.h"
+#include <algorithm>
+#include <cstring>
+#include <utility>
+#include <vector>
+
+namespace
+{
+    std::vector<std::pair<char const*, Warhead::Test::TestFunction>>& GetTests()
+    {
+        static std::vector<std::pair<char const*, Warhead::Test::TestFunction>> tests;
+        return tests;
+    }
+}
+
+bool Warhead::Test::RegisterTest(char const* name, TestFunction function)
+{
+    GetTests().emplace_back(name, function);
+    return true;
+}
+
+// Runs all test cases, or only those named as arguments
+int main(int argc, char** argv)
+{
+    std::size_t failed = 0;
+    std::size_t run = 0;
+
+    for (auto const& [name, function] : GetTests())
+    {
+        if (argc > 1 && std::none_of(argv + 1, argv + argc, [name = name](char const* arg) { return !std::strcmp(arg, name); }))
+            continue;
+
+        ++run;
+
+        try
+        {
+            function();
+            fmt::print("[ OK   ] {}\n", name);
+        }
+        catch (std::exception const& e)
+        {
+            ++failed;
+            fmt::print("[ FAIL ] {}\n         {}\n", name, e.what());
+        }
+    }
+
+    fmt::print("{} of {} test cases passed\n", run - failed, run);
+    return failed || !run ? 1 : 0;
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "AsyncLogger.h"
+#include "Config.h"
+#include "Log.h"
+#include "TestCase.h"
+#include <spdlog/sinks/base_sink.h>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+    // Holds the writer thread in its first write until released
+    class GateSink : public spdlog::sinks::base_sink<std::mutex>
+    {
+    public:
+        void WaitForFirstWrite()
+        {
+            std::unique_lock<std::mutex> lock(_gateLock);
+            _gateCondition.wait(lock, [this]() { return _entered; });
+        }
+
+        void Release()
+        {
+            std::lock_guard<std::mutex> lock(_gateLock);
+            _released = true;
+            _gateCondition.notify_all();
+        }
+
+        std::atomic<uint32> Written{ 0 };
+        std::atomic<uint32> Flushed{ 0 };
+
+    protected:
+        void sink_it_(spdlog::details::log_msg const& /*msg*/) override
+        {
+            {
+                std::unique_lock<std::mutex> lock(_gateLock);
+                _entered = true;
+                _gateCondition.notify_all();
+                _gateCondition.wait(lock, [this]() { return _released; });
+            }
+
+            Written.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        void flush_() override
+        {
+            Flushed.fetch_add(1, std::memory_order_relaxed);
+        }
+
+    private:
+        std::mutex _gateLock;
+        std::condition_variable _gateCondition;
+        bool _entered = false;
+        bool _released = false;
+    };
+
+    std::size_t CountOccurrences(std::string const& text, std::string const& pattern)
+    {
+        std::size_t count = 0;
+        for (std::size_t pos = text.find(pattern); pos != std::string::npos; pos = text.find(pattern, pos + 1))
+            ++count;
+
+        return count;
+    }
+}
+
+// A full DropOldest queue drops messages to make room, never a flush request queued between them
+TEST_CASE(DropOldestKeepsFlushRequests)
+{
+    constexpr uint32 MessageCount = 64;
+
+    auto sink = std::make_shared<GateSink>();
+    auto queue = std::make_shared<AsyncLogQueue>(8, LogOverflowPolicy::DropOldest);
+    auto logger = std::make_shared<AsyncLogger>("test", std::vector<spdlog::sink_ptr>{ sink }, queue);
+
+    logger->info("first");
+    sink->WaitForFirstWrite();
+
+    logger->flush();
+
+    for (uint32 i = 0; i < MessageCount; ++i)
+        logger->info("message {}", i);
+
+    uint64 dropped = queue->GetDroppedCount();
+
+    sink->Release();
+    queue.reset();
+
+    CHECK(dropped > 0);
+    CHECK_EQUAL(sink->Flushed.load(), uint32(1));
+    CHECK_EQUAL(sink->Written.load() + dropped, uint64(MessageCount + 1));
+}
+
+// A call site logging past its rate limit writes the limit, the rest is reported in one summary once the window expired
+TEST_CASE(RateLimitReportsSuppressedSummary)
+{
+    namespace fs = std::filesystem;
+
+    fs::path logsDir = fs::temp_directory_path() / fmt::format("warhead-log-test-{}", std::chrono::steady_clock::now().time_since_epoch().count());
+    fs::create_directories(logsDir);
+
+    fs::path configFile = logsDir / "RateLimit.conf";
+    {
+        std::ofstream dist(configFile.string() + ".dist");
+        dist << "LogsDir = \"" << logsDir.string() << "\"\n";
+        dist << "Log.Async.Enable = 1\n";
+        dist << "Sink.File = 1,0,\"%v\",\"RateLimit.log\",0,1,1\n";
+        dist << "Logger.root = 2,File,5\n";
+    }
+
+    CHECK(sConfigMgr->LoadAppConfigs(configFile.string()));
+    sLog->Initialize();
+
+    for (uint32 i = 0; i < 100; ++i)
+        LOG_ERROR("test.ratelimit", "Flood {}", i);
+
+    // The window is still open, its suppressed count is not final yet
+    sLog->FlushExpiredSuppressed();
+    LOG_ERROR("test.ratelimit", "Window open");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(1100));
+    sLog->FlushExpiredSuppressed();
+    LOG_ERROR("test.ratelimit", "Window expired");
+
+    // Writes out the async queue and closes the file
+    sLog->LoadFromConfig();
+
+    std::ifstream logFile(logsDir / "RateLimit.log");
+    std::stringstream content;
+    content << logFile.rdbuf();
+
+    CHECK_EQUAL(CountOccurrences(content.str(), "Flood "), std::size_t(5));
+    CHECK_EQUAL(CountOccurrences(content.str(), "> Suppressed "), std::size_t(1));
+    CHECK_EQUAL(CountOccurrences(content.str(), "> Suppressed 95 similar messages, rate limit of 5 per second"), std::size_t(1));
+
+    std::size_t summary = content.str().find("> Suppressed ");
+    CHECK(content.str().find("Window open") < summary);
+    CHECK(summary < content.str().find("Window expired"));
+
+    logFile.close();
+    fs::remove_all(logsDir);
+}
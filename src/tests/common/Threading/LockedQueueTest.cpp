@@ -0,0 +1,65 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "LockedQueue.h"
+#include "TestCase.h"
+#include <deque>
+#include <vector>
+
+// Everything queued moves out in order, an empty queue has nothing to drain
+TEST_CASE(DrainKeepsOrder)
+{
+    LockedQueue<int> queue;
+
+    std::deque<int> result;
+    CHECK(!queue.drain(result));
+
+    for (int i = 0; i < 5; ++i)
+        queue.add(i);
+
+    CHECK(queue.drain(result));
+    CHECK(queue.empty());
+    CHECK_EQUAL(result.size(), std::size_t(5));
+
+    for (int i = 0; i < 5; ++i)
+        CHECK_EQUAL(result[i], i);
+
+    // The queue keeps working with the container it got from the swap
+    queue.add(5);
+
+    int value = 0;
+    CHECK(queue.next(value));
+    CHECK_EQUAL(value, 5);
+}
+
+// Items drained into a container that still holds elements are appended after them
+TEST_CASE(DrainAppendsToNonEmptyResult)
+{
+    LockedQueue<int, std::vector<int>> queue;
+
+    std::vector<int> result = { -2, -1 };
+
+    for (int i = 0; i < 3; ++i)
+        queue.add(i);
+
+    CHECK(queue.drain(result));
+    CHECK(queue.empty());
+    CHECK_EQUAL(result.size(), std::size_t(5));
+
+    for (int i = 0; i < 5; ++i)
+        CHECK_EQUAL(result[i], i - 2);
+}
@@ -0,0 +1,187 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MPMCQueue.h"
+#include "TestCase.h"
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using Warhead::MPMCQueue;
+
+namespace
+{
+    struct Tracked
+    {
+        Tracked() { ++Live; }
+        ~Tracked() { --Live; }
+
+        static inline std::atomic<int> Live{ 0 };
+    };
+}
+
+// Several producers and consumers on a small ring. Every value arrives once and each consumer sees the values
+// of one producer in the order they were pushed
+TEST_CASE(ProducersAndConsumersKeepOrder)
+{
+    constexpr uint32 Producers = 3;
+    constexpr uint32 Consumers = 2;
+    constexpr uint32 Count = 100000;
+    constexpr uint32 Stop = ~uint32(0);
+
+    MPMCQueue<uint32> queue(8);
+
+    std::vector<std::thread> producers;
+    for (uint32 producer = 0; producer < Producers; ++producer)
+    {
+        producers.emplace_back([&queue, producer]()
+        {
+            for (uint32 i = 0; i < Count; ++i)
+            {
+                uint32 value = producer << 24 | i;
+                if (i % 2)
+                    queue.Push(std::move(value));
+                else
+                    while (!queue.TryPush(std::move(value)))
+                        std::this_thread::yield();
+            }
+        });
+    }
+
+    std::atomic<uint32> received{ 0 };
+    std::atomic<bool> ordered{ true };
+
+    std::vector<std::thread> consumers;
+    for (uint32 consumer = 0; consumer < Consumers; ++consumer)
+    {
+        consumers.emplace_back([&]()
+        {
+            std::vector<int64> last(Producers, -1);
+
+            uint32 value = 0;
+            while (queue.WaitAndPop(value) && value != Stop)
+            {
+                uint32 producer = value >> 24;
+                int64 sequence = value & 0xFFFFFF;
+
+                if (producer >= Producers || sequence <= last[producer])
+                    ordered = false;
+                else
+                    last[producer] = sequence;
+
+                ++received;
+            }
+        });
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    for (uint32 consumer = 0; consumer < Consumers; ++consumer)
+        queue.Push(uint32(Stop));
+
+    for (std::thread& consumer : consumers)
+        consumer.join();
+
+    CHECK(ordered);
+    CHECK_EQUAL(received.load(), Producers * Count);
+    CHECK(queue.Empty());
+}
+
+// Threads sleeping on a full or an empty queue return false once it is cancelled
+TEST_CASE(CancelWakesBlockedCalls)
+{
+    MPMCQueue<uint32> full(2);
+    CHECK(full.TryPush(1));
+    CHECK(full.TryPush(2));
+
+    MPMCQueue<uint32> empty(2);
+
+    std::atomic<int> pushResult{ -1 };
+    std::atomic<int> popResult{ -1 };
+
+    std::thread pusher([&]() { pushResult = full.Push(3); });
+    std::thread popper([&]() { uint32 value = 0; popResult = empty.WaitAndPop(value); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQUAL(pushResult.load(), -1);
+    CHECK_EQUAL(popResult.load(), -1);
+
+    full.Cancel();
+    empty.Cancel();
+
+    pusher.join();
+    popper.join();
+
+    CHECK_EQUAL(pushResult.load(), 0);
+    CHECK_EQUAL(popResult.load(), 0);
+    CHECK(full.Empty());
+
+    uint32 value = 0;
+    CHECK(!full.TryPush(4));
+    CHECK(!empty.TryPop(value));
+}
+
+// Queued pointers are deleted by Cancel and by the destructor alike
+TEST_CASE(CancelAndDestructorDeletePointers)
+{
+    {
+        MPMCQueue<Tracked*> queue(4);
+        for (int i = 0; i < 3; ++i)
+            CHECK(queue.TryPush(new Tracked()));
+
+        queue.Cancel();
+        CHECK_EQUAL(Tracked::Live.load(), 0);
+    }
+
+    {
+        MPMCQueue<Tracked*> queue(4);
+        for (int i = 0; i < 3; ++i)
+            CHECK(queue.TryPush(new Tracked()));
+
+        Tracked* popped = nullptr;
+        CHECK(queue.TryPop(popped));
+        delete popped;
+    }
+
+    CHECK_EQUAL(Tracked::Live.load(), 0);
+}
+
+// Pushes racing with Cancel either fail or have their element deleted, none is left behind
+TEST_CASE(PushRacingCancelDoesNotLeak)
+{
+    for (int round = 0; round < 200; ++round)
+    {
+        MPMCQueue<Tracked*> queue(64);
+
+        std::thread pusher([&queue]()
+        {
+            for (int i = 0; i < 32; ++i)
+            {
+                Tracked* tracked = new Tracked();
+                if (!queue.TryPush(std::move(tracked)))
+                    delete tracked;
+            }
+        });
+
+        queue.Cancel();
+        pusher.join();
+
+        CHECK_EQUAL(Tracked::Live.load(), 0);
+    }
+}
@@ -0,0 +1,149 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Define.h"
+#include "MPSCQueue.h"
+#include "TestCase.h"
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace
+{
+    struct Item
+    {
+        Item(uint32 producer, uint32 sequence) : Producer(producer), Sequence(sequence) { }
+
+        uint32 Producer;
+        uint32 Sequence;
+    };
+
+    using ItemQueue = MPSCQueueRecycled<Item>;
+}
+
+// Several producers enqueue while the consumer recycles nodes. Every item arrives once, the items of one producer in order
+TEST_CASE(ProducersKeepOrder)
+{
+    constexpr uint32 Producers = 4;
+    constexpr uint32 Count = 100000;
+
+    ItemQueue queue;
+
+    std::vector<std::thread> producers;
+    for (uint32 producer = 0; producer < Producers; ++producer)
+    {
+        producers.emplace_back([&queue, producer]()
+        {
+            for (uint32 i = 0; i < Count; ++i)
+            {
+                queue.Enqueue(new Item(producer, i));
+
+                if (!(i % 1000))
+                    std::this_thread::yield();
+            }
+        });
+    }
+
+    std::vector<uint32> next(Producers, 0);
+    uint32 received = 0;
+    bool ordered = true;
+
+    while (received < Producers * Count)
+    {
+        Item* item = nullptr;
+        if (!queue.Dequeue(item))
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        if (item->Producer >= Producers || item->Sequence != next[item->Producer])
+            ordered = false;
+        else
+            ++next[item->Producer];
+
+        ++received;
+        delete item;
+    }
+
+    for (std::thread& producer : producers)
+        producer.join();
+
+    Item* item = nullptr;
+    CHECK(ordered);
+    CHECK(!queue.Dequeue(item));
+}
+
+// Nodes a producer took from one queue's free list stay usable after that queue is destroyed
+TEST_CASE(CachedNodesOutliveTheirQueue)
+{
+    auto fillCache = [](ItemQueue& queue)
+    {
+        for (uint32 i = 0; i < 16; ++i)
+            queue.Enqueue(new Item(0, i));
+
+        Item* item = nullptr;
+        while (queue.Dequeue(item))
+            delete item;
+
+        // Takes the whole free list into the thread local cache
+        queue.Enqueue(new Item(0, 16));
+    };
+
+    auto drain = [](ItemQueue& queue)
+    {
+        uint32 count = 0;
+        Item* item = nullptr;
+        while (queue.Dequeue(item))
+        {
+            CHECK_EQUAL(item->Sequence, count++);
+            delete item;
+        }
+
+        return count;
+    };
+
+    // Cache of this thread
+    {
+        auto first = std::make_unique<ItemQueue>();
+        fillCache(*first);
+        first.reset();
+
+        ItemQueue second;
+        for (uint32 i = 0; i < 32; ++i)
+            second.Enqueue(new Item(0, i));
+
+        CHECK_EQUAL(drain(second), uint32(32));
+    }
+
+    // Cache of a producer thread, the queue it came from is destroyed while the thread keeps producing elsewhere
+    auto first = std::make_unique<ItemQueue>();
+    ItemQueue second;
+
+    std::thread producer([&]()
+    {
+        fillCache(*first);
+        first.reset();
+
+        for (uint32 i = 0; i < 32; ++i)
+            second.Enqueue(new Item(0, i));
+    });
+
+    producer.join();
+
+    CHECK_EQUAL(drain(second), uint32(32));
+}
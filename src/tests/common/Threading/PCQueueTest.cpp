@@ -0,0 +1,94 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PCQueue.h"
+#include "TestCase.h"
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <thread>
+
+// Everything pushed moves out in order and is appended after elements the container already holds
+TEST_CASE(PopAllKeepsOrder)
+{
+    ProducerConsumerQueue<int> queue;
+
+    std::deque<int> values;
+    CHECK(!queue.PopAll(values));
+
+    for (int i = 0; i < 3; ++i)
+        queue.Push(i);
+
+    CHECK(queue.PopAll(values));
+    CHECK(queue.Empty());
+
+    for (int i = 3; i < 6; ++i)
+        queue.Push(i);
+
+    CHECK(queue.PopAll(values));
+    CHECK(queue.Empty());
+    CHECK_EQUAL(values.size(), std::size_t(6));
+
+    for (int i = 0; i < 6; ++i)
+        CHECK_EQUAL(values[i], i);
+}
+
+// A consumer waiting for elements takes everything pushed before it woke up
+TEST_CASE(WaitAndPopAllReceivesPushes)
+{
+    ProducerConsumerQueue<int> queue;
+
+    std::deque<int> values = { -1 };
+
+    std::thread consumer([&]()
+    {
+        while (values.size() < 11)
+            if (!queue.WaitAndPopAll(values))
+                break;
+    });
+
+    for (int i = 0; i < 10; ++i)
+        queue.Push(i);
+
+    consumer.join();
+
+    CHECK_EQUAL(values.size(), std::size_t(11));
+
+    for (int i = 0; i < 11; ++i)
+        CHECK_EQUAL(values[i], i - 1);
+}
+
+// Cancel wakes a consumer sleeping on an empty queue
+TEST_CASE(CancelWakesWaitAndPopAll)
+{
+    ProducerConsumerQueue<int> queue;
+
+    std::atomic<int> result{ -1 };
+    std::deque<int> values;
+
+    std::thread consumer([&]() { result = queue.WaitAndPopAll(values); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    CHECK_EQUAL(result.load(), -1);
+
+    queue.Cancel();
+    consumer.join();
+
+    CHECK_EQUAL(result.load(), 0);
+    CHECK(values.empty());
+    CHECK(!queue.PopAll(values));
+}
@@ -0,0 +1,143 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "SPSCQueue.h"
+#include "TestCase.h"
+#include <array>
+#include <memory>
+#include <thread>
+
+using Warhead::SPSCQueue;
+
+// Indices keep growing, slots are reused once head and tail pass the end of the ring
+TEST_CASE(FullQueueAndWrapAround)
+{
+    SPSCQueue<uint32> queue(5);
+    CHECK_EQUAL(queue.Capacity(), std::size_t(8));
+
+    uint32 next = 0;
+    uint32 expected = 0;
+
+    for (int round = 0; round < 10; ++round)
+    {
+        while (queue.Push(next))
+            ++next;
+
+        CHECK_EQUAL(queue.Size(), std::size_t(8));
+
+        // Drain part of the ring, the next round starts in the middle of it
+        for (int i = 0; i < 5; ++i)
+        {
+            uint32 value = 0;
+            CHECK(queue.Pop(value));
+            CHECK_EQUAL(value, expected++);
+        }
+    }
+
+    uint32 value = 0;
+    while (queue.Pop(value))
+        CHECK_EQUAL(value, expected++);
+
+    CHECK_EQUAL(expected, next);
+    CHECK(queue.Empty());
+}
+
+// Elements still queued are destroyed with the queue
+TEST_CASE(DestructorReleasesQueuedElements)
+{
+    auto tracked = std::make_shared<int>(0);
+
+    {
+        SPSCQueue<std::shared_ptr<int>> queue(4);
+        for (int i = 0; i < 3; ++i)
+            CHECK(queue.Push(tracked));
+
+        std::shared_ptr<int> popped;
+        CHECK(queue.Pop(popped));
+        CHECK_EQUAL(tracked.use_count(), 4);
+    }
+
+    CHECK_EQUAL(tracked.use_count(), 1);
+}
+
+// Producer and consumer threads on a small ring, single and batch calls mixed. Every value arrives once and in order
+TEST_CASE(TwoThreadsKeepOrder)
+{
+    constexpr uint32 Count = 1000000;
+
+    SPSCQueue<uint32> queue(16);
+
+    std::thread producer([&queue]()
+    {
+        uint32 next = 0;
+        while (next < Count)
+        {
+            if (next % 3)
+            {
+                if (queue.Push(next))
+                    ++next;
+                else
+                    std::this_thread::yield();
+
+                continue;
+            }
+
+            std::array<uint32, 7> batch;
+            std::size_t size = std::min<std::size_t>(batch.size(), Count - next);
+            for (std::size_t i = 0; i < size; ++i)
+                batch[i] = next + uint32(i);
+
+            std::size_t pushed = queue.PushBatch(batch.begin(), size);
+            next += uint32(pushed);
+
+            if (!pushed)
+                std::this_thread::yield();
+        }
+    });
+
+    uint32 expected = 0;
+    bool ordered = true;
+
+    while (expected < Count)
+    {
+        std::array<uint32, 5> batch;
+        std::size_t popped = 0;
+
+        if (expected % 2)
+        {
+            if (queue.Pop(batch[0]))
+                popped = 1;
+        }
+        else
+            popped = queue.PopBatch(batch.begin(), batch.size());
+
+        if (!popped)
+        {
+            std::this_thread::yield();
+            continue;
+        }
+
+        for (std::size_t i = 0; i < popped; ++i)
+            ordered = ordered && batch[i] == expected++;
+    }
+
+    producer.join();
+
+    CHECK(ordered);
+    CHECK_EQUAL(expected, Count);
+    CHECK(queue.Empty());
+}
@@ -0,0 +1,51 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "ThreadPool.h"
+#include "TestCase.h"
+#include <stdexcept>
+
+using Warhead::ThreadPool;
+
+// A throwing task must not take its worker down, whatever it throws
+TEST_CASE(ThrowingTasksKeepWorkersRunning)
+{
+    ThreadPool pool("test pool");
+    pool.Start(2);
+
+    std::atomic<uint32> completed{ 0 };
+
+    for (uint32 i = 0; i < 100; ++i)
+    {
+        switch (i % 3)
+        {
+            case 0:
+                pool.Post([]() { throw std::runtime_error("task failure"); });
+                break;
+            case 1:
+                pool.Post([]() { throw 42; });
+                break;
+            default:
+                pool.Post([&completed]() { completed.fetch_add(1, std::memory_order_relaxed); });
+                break;
+        }
+    }
+
+    pool.Stop();
+
+    CHECK_EQUAL(completed.load(), uint32(33));
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "MessageBufferPool.h"
+#include "TestCase.h"
+#include <thread>
+
+namespace
+{
+    // Released by a thread_local destructor that runs after the pool cache of the thread is gone
+    struct ThreadExitHolder
+    {
+        ~ThreadExitHolder()
+        {
+            sMessageBufferPool->Release(std::move(Storage));
+
+            // Acquire and release again without a cache
+            std::vector<uint8> storage = sMessageBufferPool->Acquire(1000);
+            Acquired = storage.size();
+            sMessageBufferPool->Release(std::move(storage));
+        }
+
+        std::vector<uint8> Storage;
+        static inline std::size_t Acquired = 0;
+    };
+}
+
+TEST_CASE(ChunksAreReused)
+{
+    sMessageBufferPool->Reserve(64);
+
+    std::vector<uint8> storage = sMessageBufferPool->Acquire(100);
+    CHECK_EQUAL(storage.size(), MESSAGE_BUFFER_CHUNK_SIZE[0]);
+
+    uint8 const* data = storage.data();
+    sMessageBufferPool->Release(std::move(storage));
+
+    storage = sMessageBufferPool->Acquire(MESSAGE_BUFFER_CHUNK_SIZE[0]);
+    CHECK(storage.data() == data);
+    sMessageBufferPool->Release(std::move(storage));
+
+    // Sizes above the largest chunk are allocated exactly
+    storage = sMessageBufferPool->Acquire(MESSAGE_BUFFER_CHUNK_SIZE[2] + 1);
+    CHECK_EQUAL(storage.size(), MESSAGE_BUFFER_CHUNK_SIZE[2] + 1);
+    sMessageBufferPool->Release(std::move(storage));
+}
+
+TEST_CASE(ReleaseAfterThreadCacheDestroyed)
+{
+    sMessageBufferPool->Reserve(64);
+
+    MessageBufferPoolStats before = sMessageBufferPool->GetStats();
+
+    std::thread thread([]()
+    {
+        // Constructed before the cache, destroyed after it
+        thread_local ThreadExitHolder holder;
+        holder.Storage = sMessageBufferPool->Acquire(100);
+    });
+    thread.join();
+
+    MessageBufferPoolStats after = sMessageBufferPool->GetStats();
+
+    CHECK_EQUAL(ThreadExitHolder::Acquired, MESSAGE_BUFFER_CHUNK_SIZE[0]);
+    CHECK_EQUAL(after.Returns - before.Returns, uint64(2));
+}
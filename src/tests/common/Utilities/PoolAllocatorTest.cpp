@@ -0,0 +1,104 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "PoolAllocator.h"
+#include "TestCase.h"
+#include <memory>
+#include <set>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+using Warhead::PoolAllocator;
+
+namespace
+{
+    struct PooledObject
+    {
+        explicit PooledObject(uint32 value) : Value(value) { }
+
+        uint32 Value;
+        uint8 Padding[60];
+    };
+
+    struct OtherTag { };
+
+    // Control block of allocate_shared must come from the pools of the allocator's own tag
+    static_assert(std::is_same_v<std::allocator_traits<PoolAllocator<PooledObject>>::rebind_alloc<int>, PoolAllocator<int, PooledObject>>);
+
+    // Released by a thread_local destructor, possibly after the pool cache of the thread is gone
+    struct ThreadExitHolder
+    {
+        std::shared_ptr<PooledObject> Object;
+    };
+}
+
+TEST_CASE(AllocateSharedKeepsValues)
+{
+    PoolAllocator<PooledObject>::SetSlabSize(16);
+
+    std::vector<std::shared_ptr<PooledObject>> objects;
+    for (uint32 i = 0; i < 1000; ++i)
+        objects.push_back(std::allocate_shared<PooledObject>(PoolAllocator<PooledObject>(), i));
+
+    std::set<PooledObject*> addresses;
+    for (uint32 i = 0; i < objects.size(); ++i)
+    {
+        CHECK_EQUAL(objects[i]->Value, i);
+        addresses.insert(objects[i].get());
+    }
+
+    CHECK_EQUAL(addresses.size(), objects.size());
+}
+
+// Blocks freed on other threads, and from thread_local destructors at thread exit, go back to the pool intact
+TEST_CASE(CrossThreadAndThreadExitRelease)
+{
+    constexpr uint32 Count = 20000;
+
+    std::vector<std::shared_ptr<PooledObject>> objects;
+    for (uint32 i = 0; i < Count; ++i)
+        objects.push_back(std::allocate_shared<PooledObject>(PoolAllocator<PooledObject, OtherTag>(), i));
+
+    std::thread releaser([&objects]()
+    {
+        thread_local ThreadExitHolder holder;
+        holder.Object = std::move(objects.back());
+        objects.pop_back();
+
+        objects.clear();
+
+        for (uint32 i = 0; i < 100; ++i)
+            objects.push_back(std::allocate_shared<PooledObject>(PoolAllocator<PooledObject, OtherTag>(), i));
+    });
+    releaser.join();
+
+    for (uint32 i = 0; i < objects.size(); ++i)
+        CHECK_EQUAL(objects[i]->Value, i);
+
+    objects.clear();
+
+    // Everything released above is reused, a fresh round doesn't hand out a block twice
+    std::set<PooledObject*> addresses;
+    for (uint32 i = 0; i < Count; ++i)
+    {
+        objects.push_back(std::allocate_shared<PooledObject>(PoolAllocator<PooledObject, OtherTag>(), i));
+        addresses.insert(objects.back().get());
+    }
+
+    CHECK_EQUAL(addresses.size(), std::size_t(Count));
+}
@@ -0,0 +1,70 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FixJournal.h"
+#include "TestCase.h"
+#include <string>
+
+namespace
+{
+    // Standard header and trailer around body, BodyLength counts from after its own field up to the CheckSum field
+    std::string MakeMessage(std::string const& body)
+    {
+        std::string message = "8=FIX.4.4\x01" "9=" + std::to_string(body.size()) + "\x01" + body;
+
+        uint32 checkSum = 0;
+        for (char c : message)
+            checkSum += uint8(c);
+
+        return message + fmt::format("10={:03}\x01", checkSum % 256);
+    }
+
+    std::size_t Frame(std::string const& data)
+    {
+        return FixJournal::FrameMessage(reinterpret_cast<uint8 const*>(data.data()), data.size());
+    }
+}
+
+TEST_CASE(FrameSplitsConcatenatedMessages)
+{
+    std::string first = MakeMessage("35=D\x01" "34=7\x01" "49=CLIENT\x01" "56=SERVER\x01");
+    std::string second = MakeMessage("35=0\x01" "34=8\x01");
+    std::string data = first + second;
+
+    CHECK_EQUAL(Frame(data), first.size());
+    CHECK_EQUAL(Frame(data.substr(first.size())), second.size());
+    CHECK_EQUAL(FixJournal::FindMsgSeqNum(reinterpret_cast<uint8 const*>(data.data()), Frame(data)), uint32(7));
+}
+
+TEST_CASE(FrameRejectsCutAndMalformedData)
+{
+    std::string message = MakeMessage("35=D\x01" "34=7\x01");
+
+    // Every prefix of a message is cut short
+    for (std::size_t size = 0; size < message.size(); ++size)
+        CHECK_EQUAL(Frame(message.substr(0, size)), std::size_t(0));
+
+    CHECK_EQUAL(Frame("garbage" + message), std::size_t(0));
+    CHECK_EQUAL(Frame("8=FIX.4.4\x01" "35=D\x01" "10=000\x01"), std::size_t(0));
+    CHECK_EQUAL(Frame("8=FIX.4.4\x01" "9=\x01" "10=000\x01"), std::size_t(0));
+    CHECK_EQUAL(Frame("8=FIX.4.4\x01" "9=99999999999999999999\x01"), std::size_t(0));
+
+    // BodyLength one byte off misses the CheckSum field
+    std::string wrongLength = message;
+    wrongLength.replace(wrongLength.find("9=") + 2, 2, "11");
+    CHECK_EQUAL(Frame(wrongLength), std::size_t(0));
+}
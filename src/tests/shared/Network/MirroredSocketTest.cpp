@@ -0,0 +1,128 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NetworkTestUtils.h"
+#include "Socket.h"
+#include "TestCase.h"
+#include <boost/asio/write.hpp>
+#include <thread>
+
+using namespace Warhead::Test;
+
+namespace
+{
+    // Messages are "<4 digit length><payload>", payload bytes are derived from the message number
+    std::string MakeMessage(uint32 number)
+    {
+        std::string payload(100 + (number * 389) % 1400, char('a' + number % 26));
+        return fmt::format("{:04}", payload.size()) + payload;
+    }
+
+    // Takes whole messages only, a message split by the end of the buffer stays unread until the rest arrives
+    class MirroredSession : public Socket<MirroredSession, MirroredMessageBuffer>
+    {
+    public:
+        explicit MirroredSession(tcp::socket&& socket) : Socket(std::move(socket)) { }
+
+        void Start() override { AsyncRead(); }
+
+        uint32 Received{ 0 };
+        uint32 WrappedMessages{ 0 };
+        bool Mirrored{ false };
+        std::string Error;
+
+    protected:
+        void ReadHandler() override
+        {
+            MirroredMessageBuffer& buffer = GetReadBuffer();
+
+            // First read starts at the beginning of the mapping
+            if (!_base)
+            {
+                _base = buffer.GetReadPointer();
+                Mirrored = buffer.IsMirrored();
+            }
+
+            while (buffer.GetActiveSize() >= 4)
+            {
+                std::size_t size = std::stoul(std::string(reinterpret_cast<char const*>(buffer.GetReadPointer()), 4));
+                if (buffer.GetActiveSize() < size + 4)
+                    break;
+
+                std::string expected = MakeMessage(Received);
+                if (std::string(reinterpret_cast<char const*>(buffer.GetReadPointer()), size + 4) != expected && Error.empty())
+                    Error = fmt::format("message {} is corrupt", Received);
+
+                // Message continues in the second mapping
+                if (buffer.GetReadPointer() + size + 4 > _base + buffer.GetBufferSize())
+                    ++WrappedMessages;
+
+                buffer.ReadCompleted(size + 4);
+                ++Received;
+            }
+
+            AsyncRead();
+        }
+
+    private:
+        uint8* _base{ nullptr };
+    };
+}
+
+// A 4 KB ring is read many times over, messages straddling the end of the mapping arrive in one piece
+TEST_CASE(ReadsAcrossTheWrapPoint)
+{
+    SocketReadBufferSettings settings;
+    settings.MinSize = 4096;
+    settings.MaxSize = 4096;
+    MirroredSession::SetReadBufferSettings(settings);
+
+    boost::asio::io_context serverContext;
+    boost::asio::io_context clientContext;
+
+    auto [server, client] = ConnectLoopback(serverContext, clientContext);
+
+    constexpr uint32 MessageCount = 2000;
+
+    // Small writes, reads see partial messages
+    std::thread writer([&client = client]()
+    {
+        std::string data;
+        for (uint32 i = 0; i < MessageCount; ++i)
+            data += MakeMessage(i);
+
+        for (std::size_t offset = 0; offset < data.size(); offset += 1000)
+            boost::asio::write(client, boost::asio::buffer(data.data() + offset, std::min<std::size_t>(1000, data.size() - offset)));
+
+        client.shutdown(tcp::socket::shutdown_send);
+    });
+
+    auto session = std::make_shared<MirroredSession>(std::move(server));
+    session->Start();
+    serverContext.run();
+
+    writer.join();
+
+    CHECK(session->Error.empty());
+    CHECK_EQUAL(session->Received, MessageCount);
+    CHECK_EQUAL(session->GetReadBuffer().GetBufferSize(), std::size_t(4096));
+
+#ifdef __linux__
+    CHECK(session->Mirrored);
+    CHECK(session->WrappedMessages > 0);
+#endif
+}
@@ -0,0 +1,82 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _NETWORK_TEST_UTILS_H_
+#define _NETWORK_TEST_UTILS_H_
+
+#include "TestCase.h"
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/ip/tcp.hpp>
+#include <string>
+#include <utility>
+
+namespace Warhead::Test
+{
+    using boost::asio::ip::tcp;
+
+    // Connected loopback pair, first is the server end bound to serverContext, second the client end
+    inline std::pair<tcp::socket, tcp::socket> ConnectLoopback(boost::asio::io_context& serverContext, boost::asio::io_context& clientContext)
+    {
+        tcp::acceptor acceptor(clientContext, tcp::endpoint(boost::asio::ip::address_v4::loopback(), 0));
+
+        tcp::socket client(clientContext);
+        client.connect(acceptor.local_endpoint());
+
+        tcp::socket server = acceptor.accept(serverContext);
+        return { std::move(server), std::move(client) };
+    }
+
+    // Blocking read of one FIX message, up to and including the CheckSum field. Bytes after it stay in pending
+    inline std::string ReadFixMessage(tcp::socket& socket, std::string& pending)
+    {
+        for (;;)
+        {
+            std::size_t checksum = pending.find("\x01" "10=");
+            if (checksum != std::string::npos && pending.size() >= checksum + 8)
+            {
+                std::string message = pending.substr(0, checksum + 8);
+                pending.erase(0, checksum + 8);
+                return message;
+            }
+
+            char data[4096];
+            boost::system::error_code error;
+            std::size_t size = socket.read_some(boost::asio::buffer(data), error);
+            if (error)
+                Fail(__FILE__, __LINE__, "connection closed before a whole FIX message was read: " + error.message());
+
+            pending.append(data, size);
+        }
+    }
+
+    // Value of the first field with tag, empty if not present
+    inline std::string GetFixField(std::string const& message, std::string const& tag)
+    {
+        std::string key = tag + "=";
+        std::size_t start = message.compare(0, key.size(), key) == 0 ? 0 : message.find("\x01" + key);
+        if (start == std::string::npos)
+            return "";
+
+        if (start)
+            ++start;
+
+        start += key.size();
+        return message.substr(start, message.find('\x01', start) - start);
+    }
+}
+
+#endif // _NETWORK_TEST_UTILS_H_
@@ -0,0 +1,79 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NetworkTestUtils.h"
+#include "NetworkThread.h"
+#include "Socket.h"
+#include "TestCase.h"
+#include <ctime>
+#include <thread>
+
+using namespace Warhead::Test;
+
+namespace
+{
+    class IdleSession : public Socket<IdleSession>
+    {
+    public:
+        explicit IdleSession(tcp::socket&& socket) : Socket(std::move(socket)) { }
+
+        void Start() override { AsyncRead(); }
+
+    protected:
+        void ReadHandler() override { AsyncRead(); }
+    };
+
+    // CPU time of the whole process, the test thread itself only sleeps
+    double GetProcessCpuSeconds()
+    {
+        return double(std::clock()) / CLOCKS_PER_SEC;
+    }
+}
+
+// Adaptive thread with nothing but its 1 ms update timer and an idle socket must fall back to blocking in run_one().
+// The timer tick is no work, counting it would reset the idle time before it ever reaches SpinIdleTime
+TEST_CASE(IdleAdaptiveThreadBlocks)
+{
+    NetworkThread<IdleSession> thread;
+    thread.SetSpinMode(NetworkSpinMode::Adaptive, Microseconds(1000));
+    thread.Start();
+
+    boost::asio::io_context clientContext;
+    auto [server, client] = ConnectLoopback(thread.GetIoContext(), clientContext);
+
+    auto session = std::make_shared<IdleSession>(std::move(server));
+    thread.AddSocket(session);
+    Warhead::Asio::post(thread.GetIoContext(), [session]() { session->Start(); });
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+
+    double cpuStart = GetProcessCpuSeconds();
+    auto wallStart = std::chrono::steady_clock::now();
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(300));
+
+    double cpu = GetProcessCpuSeconds() - cpuStart;
+    double wall = std::chrono::duration<double>(std::chrono::steady_clock::now() - wallStart).count();
+
+    // A spinning thread uses a whole core, a blocking one wakes up once per update tick
+    CHECK(cpu < wall * 0.25);
+
+    session->CloseSocket();
+
+    thread.Stop();
+    thread.Wait();
+}
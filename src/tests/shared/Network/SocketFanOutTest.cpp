@@ -0,0 +1,156 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FixMessage.h"
+#include "NetworkTestUtils.h"
+#include "NetworkThread.h"
+#include "Socket.h"
+#include "TestCase.h"
+#include <numeric>
+
+using namespace Warhead::Test;
+
+namespace
+{
+    // Frames a shared body with its own CompIDs and sequence number, as AuthSession::SendSharedPacket does
+    class FanOutSession : public Socket<FanOutSession>
+    {
+    public:
+        FanOutSession(tcp::socket&& socket, std::string senderCompId, std::string targetCompId) : Socket(std::move(socket)),
+            _senderCompId(std::move(senderCompId)), _targetCompId(std::move(targetCompId)) { }
+
+        void Start() override { }
+
+        void SendSharedPacket(std::string_view msgType, SharedMessageBuffer const& body)
+        {
+            FixSessionHeader header;
+            header.BeginString = "FIX.5.0";
+            header.MsgType = msgType;
+            header.SenderCompID = _senderCompId;
+            header.TargetCompID = _targetCompId;
+            header.MsgSeqNum = _sendSeqNum++;
+
+            MessageBuffer prefix(std::size_t(0));
+            MessageBuffer suffix(std::size_t(0));
+            sFixMessage->WriteSessionFraming(header, body, prefix, suffix);
+
+            QueuePacket(std::move(prefix), body, std::move(suffix));
+        }
+
+    protected:
+        void ReadHandler() override { }
+
+    private:
+        std::string _senderCompId;
+        std::string _targetCompId;
+        uint32 _sendSeqNum{ 1 };
+    };
+
+    void CheckFraming(std::string const& message)
+    {
+        std::size_t bodyStart = message.find('\x01', message.find("\x01" "9=") + 1) + 1;
+        std::size_t checksumStart = message.rfind("10=");
+
+        CHECK_EQUAL(GetFixField(message, "9"), std::to_string(checksumStart - bodyStart));
+
+        uint32 sum = std::accumulate(message.begin(), message.begin() + checksumStart, uint32(0), [](uint32 total, char c) { return total + uint8(c); });
+        CHECK_EQUAL(GetFixField(message, "10"), fmt::format("{:03}", sum % 256));
+    }
+}
+
+// Body is encoded once and queued to two sessions of a running network thread, each session adds its own header
+TEST_CASE(SharedBodyGetsPerSessionHeaders)
+{
+    NetworkThread<FanOutSession> thread;
+    thread.Start();
+
+    boost::asio::io_context clientContext;
+
+    auto [server1, client1] = ConnectLoopback(thread.GetIoContext(), clientContext);
+    auto [server2, client2] = ConnectLoopback(thread.GetIoContext(), clientContext);
+
+    thread.AddSocket(std::make_shared<FanOutSession>(std::move(server1), "SERVER1", "CLIENT1"));
+    thread.AddSocket(std::make_shared<FanOutSession>(std::move(server2), "SERVER2", "CLIENT2"));
+
+    std::string const news = "148=Trading halted\x01" "58=Shared body\x01";
+
+    MessageBuffer bodyBuffer(news.size());
+    bodyBuffer.Write(news.data(), news.size());
+    SharedMessageBuffer body(std::move(bodyBuffer));
+
+    // Twice, the second message of every session has the next sequence number
+    for (int i = 0; i < 2; ++i)
+        thread.PostForEachSocket([body](std::shared_ptr<FanOutSession> const& session) { session->SendSharedPacket("B", body); });
+
+    std::string pending1, pending2;
+
+    for (uint32 seqNum = 1; seqNum <= 2; ++seqNum)
+    {
+        std::string message1 = ReadFixMessage(client1, pending1);
+        std::string message2 = ReadFixMessage(client2, pending2);
+
+        for (std::string const& message : { message1, message2 })
+        {
+            CheckFraming(message);
+            CHECK_EQUAL(GetFixField(message, "8"), "FIX.5.0");
+            CHECK_EQUAL(GetFixField(message, "35"), "B");
+            CHECK_EQUAL(GetFixField(message, "34"), std::to_string(seqNum));
+            CHECK(message.find("\x01" + news + "10=") != std::string::npos);
+        }
+
+        CHECK_EQUAL(GetFixField(message1, "49"), "SERVER1");
+        CHECK_EQUAL(GetFixField(message1, "56"), "CLIENT1");
+        CHECK_EQUAL(GetFixField(message2, "49"), "SERVER2");
+        CHECK_EQUAL(GetFixField(message2, "56"), "CLIENT2");
+    }
+
+    thread.Stop();
+    thread.Wait();
+}
+
+// CompIDs far longer than the usual header still frame into a valid message
+TEST_CASE(LongCompIDsAreFramed)
+{
+    std::string const news = "58=Shared body\x01";
+
+    MessageBuffer bodyBuffer(news.size());
+    bodyBuffer.Write(news.data(), news.size());
+    SharedMessageBuffer body(std::move(bodyBuffer));
+
+    std::string const senderCompId(300, 'S');
+    std::string const targetCompId(300, 'T');
+
+    FixSessionHeader header;
+    header.BeginString = "FIX.5.0";
+    header.MsgType = "B";
+    header.SenderCompID = senderCompId;
+    header.TargetCompID = targetCompId;
+    header.MsgSeqNum = 4000000000;
+
+    MessageBuffer prefix(std::size_t(0));
+    MessageBuffer suffix(std::size_t(0));
+    sFixMessage->WriteSessionFraming(header, body, prefix, suffix);
+
+    std::string message(reinterpret_cast<char const*>(prefix.GetReadPointer()), prefix.GetActiveSize());
+    message.append(reinterpret_cast<char const*>(body.GetData()), body.GetSize());
+    message.append(reinterpret_cast<char const*>(suffix.GetReadPointer()), suffix.GetActiveSize());
+
+    CheckFraming(message);
+    CHECK_EQUAL(GetFixField(message, "34"), "4000000000");
+    CHECK_EQUAL(GetFixField(message, "49"), senderCompId);
+    CHECK_EQUAL(GetFixField(message, "56"), targetCompId);
+}
@@ -0,0 +1,134 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NetworkTestUtils.h"
+#include "NetworkThread.h"
+#include "Socket.h"
+#include "TestCase.h"
+#include <boost/asio/write.hpp>
+#include <future>
+#include <thread>
+
+using namespace Warhead::Test;
+
+namespace
+{
+    // Messages are "<5 digit length><payload>"
+    std::string MakeMessage(std::size_t size, char fill)
+    {
+        return fmt::format("{:05}", size) + std::string(size, fill);
+    }
+
+    class MigratingSession : public Socket<MigratingSession>
+    {
+    public:
+        explicit MigratingSession(tcp::socket&& socket) : Socket(std::move(socket)) { }
+
+        void Start() override { AsyncRead(); }
+
+        std::atomic<std::size_t> Unread{ 0 };
+        std::atomic<uint32> Messages{ 0 };
+        std::atomic<bool> Corrupt{ false };
+        std::atomic<std::thread::id> LastReader;
+
+        std::string Expected;
+
+    protected:
+        void ReadHandler() override
+        {
+            MessageBuffer& buffer = GetReadBuffer();
+            LastReader = std::this_thread::get_id();
+
+            while (buffer.GetActiveSize() >= 5)
+            {
+                std::size_t size = std::stoul(std::string(reinterpret_cast<char const*>(buffer.GetReadPointer()), 5));
+                if (buffer.GetActiveSize() < size + 5)
+                    break;
+
+                if (std::string(reinterpret_cast<char const*>(buffer.GetReadPointer()), size + 5) != Expected)
+                    Corrupt = true;
+
+                buffer.ReadCompleted(size + 5);
+                ++Messages;
+            }
+
+            Unread = buffer.GetActiveSize();
+            AsyncRead();
+        }
+    };
+
+    template<typename Predicate>
+    bool WaitFor(Predicate predicate)
+    {
+        for (int i = 0; i < 2000 && !predicate(); ++i)
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        return predicate();
+    }
+
+    std::thread::id GetThreadId(NetworkThread<MigratingSession>& thread)
+    {
+        std::promise<std::thread::id> id;
+        Warhead::Asio::post(thread.GetIoContext(), [&id]() { id.set_value(std::this_thread::get_id()); });
+        return id.get_future().get();
+    }
+}
+
+// Session is moved while the rest of a partial message is being read. The pending read is cancelled,
+// the session continues on the target thread with its unread data instead of being closed
+TEST_CASE(MigrateWithUnreadData)
+{
+    NetworkThread<MigratingSession> source;
+    NetworkThread<MigratingSession> target;
+    source.Start();
+    target.Start();
+
+    std::thread::id targetThreadId = GetThreadId(target);
+
+    boost::asio::io_context clientContext;
+    auto [server, client] = ConnectLoopback(source.GetIoContext(), clientContext);
+
+    std::string const message = MakeMessage(3000, 'M');
+
+    auto session = std::make_shared<MigratingSession>(std::move(server));
+    session->Expected = message;
+
+    source.AddSocket(session);
+    Warhead::Asio::post(source.GetIoContext(), [session]() { session->Start(); });
+
+    boost::asio::write(client, boost::asio::buffer(message.data(), 1000));
+    CHECK(WaitFor([&session]() { return session->Unread == 1000; }));
+
+    source.PostMoveSession(session, target);
+    CHECK(WaitFor([&target]() { return target.GetConnectionCount() == 1; }));
+    CHECK_EQUAL(source.GetConnectionCount(), 0);
+    CHECK(session->IsOpen());
+
+    boost::asio::write(client, boost::asio::buffer(message.data() + 1000, message.size() - 1000));
+    CHECK(WaitFor([&session]() { return session->Messages == 1; }));
+
+    CHECK(!session->Corrupt);
+    CHECK(session->IsOpen());
+    CHECK(session->LastReader.load() == targetThreadId);
+
+    session->CloseSocket();
+
+    source.Stop();
+    target.Stop();
+    source.Wait();
+    target.Wait();
+}
@@ -0,0 +1,180 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "NetworkTestUtils.h"
+#include "Socket.h"
+#include "TestCase.h"
+#include <boost/asio/write.hpp>
+#include <thread>
+
+using namespace Warhead::Test;
+
+namespace
+{
+    // Messages are "<5 digit length><payload>"
+    std::string MakeMessage(std::size_t size, char fill)
+    {
+        return fmt::format("{:05}", size) + std::string(size, fill);
+    }
+
+    class ReadBufferSession : public Socket<ReadBufferSession>
+    {
+    public:
+        explicit ReadBufferSession(tcp::socket&& socket) : Socket(std::move(socket)) { }
+
+        void Start() override { AsyncRead(); }
+
+        std::vector<std::string> Messages;
+
+    protected:
+        void ReadHandler() override
+        {
+            MessageBuffer& buffer = GetReadBuffer();
+
+            while (buffer.GetActiveSize() >= 5)
+            {
+                std::size_t size = std::stoul(std::string(reinterpret_cast<char const*>(buffer.GetReadPointer()), 5));
+                if (buffer.GetActiveSize() < size + 5)
+                    break;
+
+                Messages.emplace_back(reinterpret_cast<char const*>(buffer.GetReadPointer()), size + 5);
+                buffer.ReadCompleted(size + 5);
+            }
+
+            AsyncRead();
+        }
+    };
+
+    template<typename Predicate>
+    bool RunUntil(boost::asio::io_context& context, Predicate predicate)
+    {
+        for (int i = 0; i < 2000 && !predicate(); ++i)
+        {
+            context.restart();
+            context.run_for(std::chrono::milliseconds(1));
+        }
+
+        return predicate();
+    }
+}
+
+// Read buffer grown by a large message shrinks while the next message is half read. The shrink must not move
+// storage a pending read writes into, the rest of the message has to arrive intact
+TEST_CASE(IdleShrinkKeepsPendingRead)
+{
+    SocketReadBufferSettings settings;
+    settings.MinSize = 4096;
+    settings.MaxSize = 64 * 1024;
+    settings.ShrinkIdleTime = Milliseconds(1);
+    ReadBufferSession::SetReadBufferSettings(settings);
+
+    boost::asio::io_context serverContext;
+    boost::asio::io_context clientContext;
+
+    auto [server, client] = ConnectLoopback(serverContext, clientContext);
+
+    auto session = std::make_shared<ReadBufferSession>(std::move(server));
+    session->Start();
+
+    std::string const large = MakeMessage(40000, 'L');
+    std::string const next = MakeMessage(3000, 'N');
+
+    // Large message grows the buffer, the first part of the next one stays unread in it
+    std::string data = large + next.substr(0, 1000);
+    boost::asio::write(client, boost::asio::buffer(data));
+
+    CHECK(RunUntil(serverContext, [&session = session]() { return session->Messages.size() == 1 && session->GetReadBuffer().GetActiveSize() == 1000; }));
+    CHECK(session->GetReadBuffer().GetBufferSize() > settings.MinSize);
+
+    // Read of the rest is pending now, idle time passes and the network thread updates the socket
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    CHECK(session->Update());
+
+    boost::asio::write(client, boost::asio::buffer(next.substr(1000)));
+
+    CHECK(RunUntil(serverContext, [&session = session]() { return session->Messages.size() == 2; }));
+    CHECK(session->Messages[0] == large);
+    CHECK(session->Messages[1] == next);
+
+    // Smaller size is applied by the read that follows, the socket just got data and keeps reading into its buffer
+    CHECK_EQUAL(session->GetReadBuffer().GetBufferSize(), settings.MinSize);
+
+    session->CloseSocket();
+}
+
+// Active socket keeps its empty buffer for the next read, once idle for ShrinkIdleTime it gives it back to the pool
+TEST_CASE(IdleSocketReleasesEmptyBuffer)
+{
+    SocketReadBufferSettings settings;
+    settings.MinSize = 4096;
+    settings.MaxSize = 64 * 1024;
+    settings.ShrinkIdleTime = Milliseconds(20);
+    ReadBufferSession::SetReadBufferSettings(settings);
+
+    boost::asio::io_context serverContext;
+    boost::asio::io_context clientContext;
+
+    auto [server, client] = ConnectLoopback(serverContext, clientContext);
+
+    auto session = std::make_shared<ReadBufferSession>(std::move(server));
+    session->Start();
+
+    // New socket waits for its first data without storage
+    CHECK_EQUAL(session->GetReadBuffer().GetBufferSize(), std::size_t(0));
+
+    std::string const first = MakeMessage(100, 'A');
+    boost::asio::write(client, boost::asio::buffer(first));
+
+    CHECK(RunUntil(serverContext, [&session = session]() { return session->Messages.size() == 1; }));
+    CHECK(session->Update());
+    CHECK_EQUAL(session->GetReadBuffer().GetActiveSize(), std::size_t(0));
+    CHECK_EQUAL(session->GetReadBuffer().GetBufferSize(), settings.MinSize);
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(30));
+    CHECK(session->Update());
+
+    CHECK(RunUntil(serverContext, [&session = session]() { return session->GetReadBuffer().GetBufferSize() == 0; }));
+
+    std::string const second = MakeMessage(200, 'B');
+    boost::asio::write(client, boost::asio::buffer(second));
+
+    CHECK(RunUntil(serverContext, [&session = session]() { return session->Messages.size() == 2; }));
+    CHECK(session->Messages[0] == first);
+    CHECK(session->Messages[1] == second);
+    CHECK(session->IsOpen());
+
+    session->CloseSocket();
+}
+
+// Buffers grown up to the default MaxSize come from the pool
+TEST_CASE(DefaultMaxSizeIsPooled)
+{
+    SocketReadBufferSettings settings;
+    CHECK_EQUAL(MessageBufferPool::GetStorageSize(settings.MaxSize), settings.MaxSize);
+
+    std::size_t missesBefore = sMessageBufferPool->GetStats().Misses;
+
+    std::vector<uint8> storage = sMessageBufferPool->Acquire(settings.MaxSize);
+    sMessageBufferPool->Release(std::move(storage));
+
+    storage = sMessageBufferPool->Acquire(settings.MaxSize);
+    CHECK_EQUAL(storage.size(), settings.MaxSize);
+    sMessageBufferPool->Release(std::move(storage));
+
+    // Only the first acquire allocates
+    CHECK_EQUAL(sMessageBufferPool->GetStats().Misses, missesBefore + 1);
+}
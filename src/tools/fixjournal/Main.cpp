@@ -0,0 +1,201 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "FixJournal.h"
+#include "StringConvert.h"
+#include <fmt/chrono.h>
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <optional>
+#include <vector>
+
+namespace
+{
+    struct Filter
+    {
+        std::optional<uint32> SessionId;
+        std::optional<FixJournalRecordType> Type;
+        std::string MsgType;    // Empty - any
+
+        bool Matches(FixJournalRecordHeader const& header, std::string_view message) const
+        {
+            if (SessionId && header.SessionId != *SessionId)
+                return false;
+
+            if (Type && header.Type != *Type)
+                return false;
+
+            if (!MsgType.empty())
+            {
+                if (header.Type != FixJournalRecordType::Inbound && header.Type != FixJournalRecordType::Outbound)
+                    return false;
+
+                if (message.find("\x01" "35=" + MsgType + "\x01") == std::string_view::npos)
+                    return false;
+            }
+
+            return true;
+        }
+    };
+
+    std::string_view GetTypeName(FixJournalRecordType type)
+    {
+        switch (type)
+        {
+            case FixJournalRecordType::Inbound:         return "IN   ";
+            case FixJournalRecordType::Outbound:        return "OUT  ";
+            case FixJournalRecordType::SessionOpen:     return "OPEN ";
+            case FixJournalRecordType::SessionClose:    return "CLOSE";
+            case FixJournalRecordType::InboundFragment: return "FRAG ";
+            default:                                    return "?    ";
+        }
+    }
+
+    std::string FormatTime(int64 time)
+    {
+        std::time_t seconds = static_cast<std::time_t>(time / 1000000000);
+        return fmt::format("{:%Y-%m-%d %H:%M:%S}.{:09}", fmt::localtime(seconds), time % 1000000000);
+    }
+
+    // Returns false if the file is not a journal or ends with a broken record
+    bool DecodeFile(char const* fileName, Filter const& filter)
+    {
+        std::ifstream in(fileName, std::ios::binary);
+        if (in.fail())
+        {
+            fmt::print("Runtime-Error: Can't open '{}'\n", fileName);
+            return false;
+        }
+
+        std::vector<char> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+        if (file.size() < sizeof(FIX_JOURNAL_MAGIC) || std::memcmp(file.data(), FIX_JOURNAL_MAGIC, sizeof(FIX_JOURNAL_MAGIC)) != 0)
+        {
+            fmt::print("Runtime-Error: '{}' is not a FIX journal file\n", fileName);
+            return false;
+        }
+
+        std::size_t position = sizeof(FIX_JOURNAL_MAGIC);
+        std::string message;
+
+        while (position + sizeof(FixJournalRecordHeader) <= file.size())
+        {
+            FixJournalRecordHeader header;
+            std::memcpy(&header, file.data() + position, sizeof(header));
+
+            // End of written records
+            if (!header.Size && !header.Time)
+                return true;
+
+            position += sizeof(header);
+
+            if (file.size() - position < header.Size)
+                break;
+
+            message.assign(file.data() + position, header.Size);
+            position += header.Size;
+
+            if (!filter.Matches(header, message))
+                continue;
+
+            // Field delimiter SOH is not printable
+            std::replace(message.begin(), message.end(), '\x01', '|');
+
+            fmt::print("[{}] {} session {} seq {}: {}\n", FormatTime(header.Time), GetTypeName(header.Type), header.SessionId, header.MsgSeqNum, message);
+        }
+
+        if (position == file.size())
+            return true;
+
+        fmt::print("Runtime-Error: Truncated record at offset {} of '{}'\n", position, fileName);
+        return false;
+    }
+
+    void PrintUsage(char const* name)
+    {
+        fmt::print("Usage: {} [-s session id] [-d in|out|open|close|frag] [-t MsgType] <journal file>...\n", name);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    Filter filter;
+    std::vector<char const*> files;
+
+    for (int count = 1; count < argc; ++count)
+    {
+        std::string_view arg = argv[count];
+
+        if (arg == "-s" || arg == "-d" || arg == "-t")
+        {
+            if (++count >= argc)
+            {
+                fmt::print("Runtime-Error: {} option requires an input argument\n", arg);
+                return 1;
+            }
+
+            std::string_view value = argv[count];
+
+            if (arg == "-s")
+            {
+                filter.SessionId = Warhead::StringTo<uint32>(value);
+                if (!filter.SessionId)
+                {
+                    fmt::print("Runtime-Error: Bad session id '{}'\n", value);
+                    return 1;
+                }
+            }
+            else if (arg == "-d")
+            {
+                if (value == "in")
+                    filter.Type = FixJournalRecordType::Inbound;
+                else if (value == "out")
+                    filter.Type = FixJournalRecordType::Outbound;
+                else if (value == "open")
+                    filter.Type = FixJournalRecordType::SessionOpen;
+                else if (value == "close")
+                    filter.Type = FixJournalRecordType::SessionClose;
+                else if (value == "frag")
+                    filter.Type = FixJournalRecordType::InboundFragment;
+                else
+                {
+                    PrintUsage(argv[0]);
+                    return 1;
+                }
+            }
+            else
+                filter.MsgType = value;
+        }
+        else
+            files.push_back(argv[count]);
+    }
+
+    if (files.empty())
+    {
+        PrintUsage(argv[0]);
+        return 1;
+    }
+
+    bool success = true;
+
+    for (char const* fileName : files)
+        success = DecodeFile(fileName, filter) && success;
+
+    return success ? 0 : 1;
+}
@@ -0,0 +1,146 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "DeferredLog.h"
+#include <fmt/chrono.h>
+#include <fstream>
+#include <iterator>
+#include <unordered_map>
+#include <vector>
+
+using namespace Warhead::DeferredLog;
+
+namespace
+{
+    constexpr char const* LEVEL_NAMES[] = { "trace", "debug", "info", "warning", "error", "critical", "off" };
+
+    template<typename T>
+    bool Get(uint8 const*& data, uint8 const* end, T& value)
+    {
+        if (std::size_t(end - data) < sizeof(T))
+            return false;
+
+        std::memcpy(&value, data, sizeof(T));
+        data += sizeof(T);
+        return true;
+    }
+
+    bool GetString(uint8 const*& data, uint8 const* end, std::string& value)
+    {
+        uint32 length = 0;
+        if (!Get(data, end, length) || std::size_t(end - data) < length)
+            return false;
+
+        value.assign(reinterpret_cast<char const*>(data), length);
+        data += length;
+        return true;
+    }
+
+    bool ReadCallSite(uint8 const*& data, uint8 const* end, CallSiteInfo& site)
+    {
+        return Get(data, end, site.Id) && Get(data, end, site.Level) && Get(data, end, site.Line) && GetString(data, end, site.Filter) &&
+            GetString(data, end, site.Format) && GetString(data, end, site.File) && GetString(data, end, site.Function);
+    }
+
+    std::string FormatTime(int64 time)
+    {
+        std::time_t seconds = static_cast<std::time_t>(time / 1000000000);
+        return fmt::format("{:%Y-%m-%d %H:%M:%S}.{:06}", fmt::localtime(seconds), (time % 1000000000) / 1000);
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc != 2)
+    {
+        fmt::print("Usage: {} <binary log file>\n", argv[0]);
+        return 1;
+    }
+
+    std::ifstream in(argv[1], std::ios::binary);
+    if (in.fail())
+    {
+        fmt::print("Runtime-Error: Can't open '{}'\n", argv[1]);
+        return 1;
+    }
+
+    std::vector<uint8> file((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+
+    if (file.size() < sizeof(FILE_MAGIC) || std::memcmp(file.data(), FILE_MAGIC, sizeof(FILE_MAGIC)) != 0)
+    {
+        fmt::print("Runtime-Error: '{}' is not a binary log file\n", argv[1]);
+        return 1;
+    }
+
+    std::unordered_map<uint32, CallSiteInfo> callSites;
+    std::string message;
+
+    uint8 const* data = file.data() + sizeof(FILE_MAGIC);
+    uint8 const* end = file.data() + file.size();
+
+    while (data < end)
+    {
+        RecordType type{};
+        Get(data, end, type);
+
+        if (type == RecordType::CallSite)
+        {
+            CallSiteInfo site;
+            if (!ReadCallSite(data, end, site))
+                break;
+
+            callSites[site.Id] = std::move(site);
+            continue;
+        }
+
+        uint32 id = 0;
+        uint32 argsSize = 0;
+        int64 time = 0;
+        uint32 threadId = 0;
+
+        if (type != RecordType::Message || !Get(data, end, id) || !Get(data, end, argsSize) || !Get(data, end, time) ||
+            !Get(data, end, threadId) || std::size_t(end - data) < argsSize)
+            break;
+
+        uint8 const* args = data;
+        data += argsSize;
+
+        auto itr = callSites.find(id);
+        if (itr == callSites.end())
+        {
+            fmt::print("Runtime-Error: Message of unknown call site {}\n", id);
+            continue;
+        }
+
+        CallSiteInfo const& site = itr->second;
+
+        message.clear();
+        if (!FormatMessage(site.Format, args, argsSize, message))
+            message = fmt::format("Malformed arguments for '{}'", site.Format);
+
+        fmt::print("[{}] [{}] [{}] [{}] {}\n", FormatTime(time), site.Level < std::size(LEVEL_NAMES) ? LEVEL_NAMES[site.Level] : "?",
+            site.Filter, threadId, message);
+    }
+
+    if (data != end)
+    {
+        fmt::print("Runtime-Error: Truncated or corrupted record at offset {}\n", file.size() - std::size_t(end - data));
+        return 1;
+    }
+
+    return 0;
+}
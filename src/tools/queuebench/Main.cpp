@@ -0,0 +1,147 @@
+/*
+ * This file is part of the WarheadCore Project. See AUTHORS file for Copyright information
+ *
+ * This program is free software; you can redistribute it and/or modify it
+ * under the terms of the GNU Affero General Public License as published by the
+ * Free Software Foundation; either version 3 of the License, or (at your
+ * option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful, but WITHOUT
+ * ANY WARRANTY; without even the implied warranty of MERCHANTABILITY or
+ * FITNESS FOR A PARTICULAR PURPOSE. See the GNU Affero General Public License for
+ * more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Define.h"
+#include "MPSCQueue.h"
+#include <algorithm>
+#include <chrono>
+#include <fmt/format.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Throughput of MPSCQueue against MPSCQueueRecycled with 1, 4 and 16 producers and one consumer.
+// Messages are preallocated, so only the queue nodes go through the allocator (or the free list)
+
+namespace
+{
+    struct BenchMessage
+    {
+        uint32 Producer;
+        uint64 Sequence;
+    };
+
+    template<typename Queue>
+    double Run(uint32 producers, uint64 perProducer, bool& ordered)
+    {
+        Queue queue;
+        std::vector<BenchMessage> messages(producers * perProducer);
+        std::vector<std::thread> threads;
+        threads.reserve(producers);
+
+        auto start = std::chrono::steady_clock::now();
+
+        for (uint32 producer = 0; producer < producers; ++producer)
+        {
+            threads.emplace_back([&queue, &messages, producer, perProducer]()
+            {
+                for (uint64 i = 0; i < perProducer; ++i)
+                {
+                    BenchMessage* message = &messages[producer * perProducer + i];
+                    message->Producer = producer;
+                    message->Sequence = i;
+                    queue.Enqueue(message);
+                }
+            });
+        }
+
+        // Each producer's messages must come out in the order it enqueued them
+        std::vector<uint64> nextSequence(producers, 0);
+        uint64 total = producers * perProducer;
+        uint64 received = 0;
+        BenchMessage* message = nullptr;
+
+        while (received < total)
+        {
+            if (!queue.Dequeue(message))
+            {
+                std::this_thread::yield();
+                continue;
+            }
+
+            ordered = ordered && message->Sequence == nextSequence[message->Producer]++;
+            ++received;
+        }
+
+        double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        for (std::thread& thread : threads)
+            thread.join();
+
+        return double(total) / seconds / 1000000.0;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    if (argc > 3)
+    {
+        fmt::print("Usage: {} [messages per run, default 8000000] [runs, default 3]\n", argv[0]);
+        return 1;
+    }
+
+    uint64 messageCount = 8000000;
+    uint32 runs = 3;
+
+    try
+    {
+        if (argc > 1)
+            messageCount = std::stoull(argv[1]);
+
+        if (argc > 2)
+            runs = uint32(std::stoul(argv[2]));
+    }
+    catch (std::exception const&)
+    {
+        fmt::print("Runtime-Error: Invalid argument\n");
+        return 1;
+    }
+
+    if (!messageCount || !runs)
+    {
+        fmt::print("Runtime-Error: Message count and runs must be positive\n");
+        return 1;
+    }
+
+    bool ordered = true;
+
+    fmt::print("{} messages, average of {} runs\n\n", messageCount, runs);
+    fmt::print("  producers   new/delete    recycled\n");
+
+    for (uint32 producers : { 1, 4, 16 })
+    {
+        uint64 perProducer = std::max<uint64>(messageCount / producers, 1);
+        double plain = 0.0;
+        double recycled = 0.0;
+
+        for (uint32 run = 0; run < runs; ++run)
+        {
+            plain += Run<MPSCQueue<BenchMessage>>(producers, perProducer, ordered);
+            recycled += Run<MPSCQueueRecycled<BenchMessage>>(producers, perProducer, ordered);
+        }
+
+        fmt::print("  {:>9}   {:>6.1f} M/s    {:>6.1f} M/s\n", producers, plain / runs, recycled / runs);
+    }
+
+    if (!ordered)
+    {
+        fmt::print("Runtime-Error: Messages of a producer were dequeued out of order\n");
+        return 1;
+    }
+
+    return 0;
+}